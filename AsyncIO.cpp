@@ -0,0 +1,744 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "AsyncIO.h"
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define ASYNCIO_URING 1
+#endif
+#endif
+#endif
+using namespace std;
+/**
+ * Async I/O
+ *
+ * The io_uring engine follows the kernel's ring protocol directly: we own the submission tail
+ * 		and the completion head, the kernel owns the other ends. Tails are published with a
+ * 		release store and read with an acquire load so the entries are visible before the index.
+ */
+
+/**
+ * @brief Skip the bytes of a message that were sent
+ */
+static void skipSent(vector<struct iovec> &parts, size_t sent) {
+	size_t numSent = 0;
+	while (numSent < parts.size() && sent >= parts[numSent].iov_len) {
+		sent -= parts[numSent].iov_len;
+		numSent++;
+	}
+	parts.erase(parts.begin(), parts.begin() + numSent);
+
+	if (!parts.empty()) {
+		parts[0].iov_base = (char *) parts[0].iov_base + sent;
+		parts[0].iov_len -= sent;
+	}
+}
+
+/**
+ * @brief Starts out on the epoll engine until init() is called
+ */
+AsyncIO::AsyncIO() {
+}
+
+/**
+ * @brief Release the ring (and epoll)
+ *
+ * Closing the ring waits for anything the kernel still has in flight.
+ */
+AsyncIO::~AsyncIO() {
+	this->closeRing();
+	if (this->epollFD >= 0) close(this->epollFD);
+}
+
+/**
+ * @brief Unmap the ring and close it
+ */
+void AsyncIO::closeRing() {
+#ifdef ASYNCIO_URING
+	if (this->sqeMemory != nullptr) munmap(this->sqeMemory, this->sqeMemorySize);
+	if (this->cqRing != nullptr && this->cqRing != this->sqRing) munmap(this->cqRing, this->cqRingSize);
+	if (this->sqRing != nullptr) munmap(this->sqRing, this->sqRingSize);
+#endif
+	this->sqRing = this->cqRing = this->sqeMemory = nullptr;
+
+	if (this->ringFD >= 0) close(this->ringFD);
+	this->ringFD = -1;
+}
+
+/**
+ * @brief Set up io_uring, or stay on epoll if the kernel doesn't have it (or every operation we use)
+ *
+ * @param queueDepth Max operations in the ring at once
+ * @return int (AsyncIO::ENGINE_X in use)
+ */
+int AsyncIO::init(unsigned int queueDepth) {
+#ifdef ASYNCIO_URING
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	this->ringFD = syscall(__NR_io_uring_setup, queueDepth, &params);
+	if (this->ringFD < 0) {
+		this->ringFD = -1;
+		return this->engine;
+	}
+
+	// Ask the kernel which operations it has - a ring without them is no use to us
+	if (!this->hasOperations()) {
+		this->closeRing();
+		return this->engine;
+	}
+
+	this->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	this->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	this->sqeMemorySize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	// Newer kernels map both rings at once
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		this->sqRingSize = this->cqRingSize = max(this->sqRingSize, this->cqRingSize);
+	}
+
+	this->sqRing = mmap(nullptr, this->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ringFD, IORING_OFF_SQ_RING);
+	if (this->sqRing == MAP_FAILED) {
+		this->sqRing = nullptr;
+	} else if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		this->cqRing = this->sqRing;
+	} else {
+		this->cqRing = mmap(nullptr, this->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ringFD, IORING_OFF_CQ_RING);
+		if (this->cqRing == MAP_FAILED) this->cqRing = nullptr;
+	}
+
+	this->sqeMemory = mmap(nullptr, this->sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ringFD, IORING_OFF_SQES);
+	if (this->sqeMemory == MAP_FAILED) this->sqeMemory = nullptr;
+
+	// Couldn't map everything? Give it all back and stay on epoll.
+	if (this->sqRing == nullptr || this->cqRing == nullptr || this->sqeMemory == nullptr) {
+		this->closeRing();
+		return this->engine;
+	}
+
+	char *sqBase = (char *) this->sqRing;
+	char *cqBase = (char *) this->cqRing;
+	this->sqHead = (unsigned int *) (sqBase + params.sq_off.head);
+	this->sqTail = (unsigned int *) (sqBase + params.sq_off.tail);
+	this->sqMask = (unsigned int *) (sqBase + params.sq_off.ring_mask);
+	this->sqArray = (unsigned int *) (sqBase + params.sq_off.array);
+	this->cqHead = (unsigned int *) (cqBase + params.cq_off.head);
+	this->cqTail = (unsigned int *) (cqBase + params.cq_off.tail);
+	this->cqMask = (unsigned int *) (cqBase + params.cq_off.ring_mask);
+	this->cqes = cqBase + params.cq_off.cqes;
+
+	this->numEntries = params.sq_entries;
+	this->engine = ENGINE_IO_URING;
+#else
+	(void) queueDepth;
+#endif
+
+	return this->engine;
+}
+
+/**
+ * @brief Does the kernel have every operation we use? (IORING_REGISTER_PROBE)
+ *
+ * Kernels too old to answer (before 5.6) don't have the plain read / write / recv either.
+ */
+bool AsyncIO::hasOperations() {
+#ifdef ASYNCIO_URING
+	const int numProbeOps = 256;
+	vector<char> probeMemory(sizeof(struct io_uring_probe) + numProbeOps * sizeof(struct io_uring_probe_op), 0);
+	struct io_uring_probe *probe = (struct io_uring_probe *) probeMemory.data();
+
+	if (syscall(__NR_io_uring_register, this->ringFD, IORING_REGISTER_PROBE, probe, numProbeOps) < 0) {
+		return false;
+	}
+
+	const int neededOps[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_SENDMSG, IORING_OP_RECV };
+	for (int op : neededOps) {
+		if (op >= probe->ops_len || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+			return false;
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * @brief The engine in use
+ *
+ * @return int (AsyncIO::ENGINE_X)
+ */
+int AsyncIO::getEngine() {
+	return this->engine;
+}
+
+/**
+ * @brief Readable engine name (for statistics)
+ */
+string AsyncIO::getEngineName(int engine) {
+	return (engine == ENGINE_IO_URING) ? "io_uring" : "epoll (pread/pwrite for files)";
+}
+
+/**
+ * @brief Register a buffer for fixed-buffer operations
+ *
+ * Operations on memory inside the buffer skip the per-operation page mapping. Replaces any
+ * 		buffer registered before - only call it while nothing is in flight.
+ *
+ * @return bool (false = not registered - operations still work, just without the fixed buffer)
+ */
+bool AsyncIO::registerBuffer(char *buffer, size_t size) {
+#ifdef ASYNCIO_URING
+	if (this->engine != ENGINE_IO_URING || buffer == nullptr || size == 0) {
+		return false;
+	}
+
+	if (this->registeredBuffer != nullptr) {
+		syscall(__NR_io_uring_register, this->ringFD, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+		this->registeredBuffer = nullptr;
+		this->registeredSize = 0;
+	}
+
+	// Fails if the buffer is over the locked memory limit
+	struct iovec region = { buffer, size };
+	if (syscall(__NR_io_uring_register, this->ringFD, IORING_REGISTER_BUFFERS, &region, 1) < 0) {
+		return false;
+	}
+
+	this->registeredBuffer = buffer;
+	this->registeredSize = size;
+	return true;
+#else
+	(void) buffer;
+	(void) size;
+	return false;
+#endif
+}
+
+/**
+ * @brief Is a buffer registered?
+ */
+bool AsyncIO::isBufferRegistered() {
+	return this->registeredBuffer != nullptr;
+}
+
+/**
+ * @brief Read from a file at an offset
+ *
+ * @return bool (false = the engine failed - nothing was submitted)
+ */
+bool AsyncIO::submitRead(int fd, char *buffer, size_t len, long long offset, uint64_t tag) {
+	Operation operation = Operation();
+	operation.tag = tag;
+	operation.fd = fd;
+	operation.type = OP_READ;
+	operation.buffer = buffer;
+	operation.len = len;
+	operation.offset = offset;
+
+	return this->submit(operation);
+}
+
+/**
+ * @brief Write to a file at an offset
+ *
+ * The buffer has to stay put until the write's completion is handed out.
+ *
+ * @return bool (false = the engine failed - nothing was submitted)
+ */
+bool AsyncIO::submitWrite(int fd, const char *buffer, size_t len, long long offset, uint64_t tag) {
+	Operation operation = Operation();
+	operation.tag = tag;
+	operation.fd = fd;
+	operation.type = OP_WRITE;
+	operation.buffer = (char *) buffer;
+	operation.len = len;
+	operation.offset = offset;
+
+	return this->submit(operation);
+}
+
+/**
+ * @brief Send a message on a socket (all of it - the completion is the whole length, or -errno)
+ *
+ * The list of parts is copied, but the data they point at has to stay put until the completion
+ * 		is handed out.
+ *
+ * @return bool (false = the engine failed - nothing was submitted)
+ */
+bool AsyncIO::submitSend(int fd, const struct iovec *parts, int numParts, uint64_t tag) {
+	Operation operation = Operation();
+	operation.tag = tag;
+	operation.fd = fd;
+	operation.type = OP_SEND;
+	operation.parts.assign(parts, parts + numParts);
+	for (int i = 0; i < numParts; i++) {
+		operation.len += parts[i].iov_len;
+	}
+
+	return this->submit(operation);
+}
+
+/**
+ * @brief Receive from a socket (like recv() - whatever has arrived, up to len)
+ *
+ * With MSG_DONTWAIT in the flags it doesn't wait for data: nothing there is -EAGAIN.
+ *
+ * @return bool (false = the engine failed - nothing was submitted)
+ */
+bool AsyncIO::submitRecv(int fd, char *buffer, size_t len, int flags, uint64_t tag) {
+	Operation operation = Operation();
+	operation.tag = tag;
+	operation.fd = fd;
+	operation.type = OP_RECV;
+	operation.buffer = buffer;
+	operation.len = len;
+	operation.flags = flags;
+
+	return this->submit(operation);
+}
+
+/**
+ * @brief Keep an operation until it finishes
+ *
+ * @return int (its slot - the io_uring user data)
+ */
+int AsyncIO::addOperation(const Operation &operation) {
+	if (this->freeOperations.empty()) {
+		this->operations.push_back(operation);
+		return this->operations.size() - 1;
+	}
+
+	int slot = this->freeOperations.back();
+	this->freeOperations.pop_back();
+	this->operations[slot] = operation;
+	return slot;
+}
+
+/**
+ * @brief Queue an operation
+ *
+ * With io_uring it's placed in the ring and handed to the kernel by the next getCompletion()
+ * 		(so operations submitted together go in with one system call).
+ *
+ * With epoll, files are read / written right here, and sockets are tried right here - if they
+ * 		aren't ready, getCompletion() waits for them.
+ *
+ * @return bool (false = the ring failed - the operation wasn't queued)
+ */
+bool AsyncIO::submit(Operation &operation) {
+	this->numOperations++;
+	this->numInFlight++;
+
+	if (this->engine != ENGINE_IO_URING) {
+		long long result;
+		if (operation.type == OP_READ || operation.type == OP_WRITE) {
+			result = this->finishSync(operation, 0);
+		} else if (!this->trySocket(operation, result, false)) {
+			this->waitingOperations.push_back(this->addOperation(operation));
+			return true;
+		}
+
+		Completion completion = { operation.tag, result };
+		this->completed.push_back(completion);
+		return true;
+	}
+
+#ifdef ASYNCIO_URING
+	// Everything in the ring (or the kernel) already? Wait for room so the completion queue can't overflow.
+	while (this->numInFlight - (int) this->completed.size() > (int) this->numEntries) {
+		if (this->enter(this->numUnsubmitted, 1) < 0) {
+			this->numOperations--;
+			this->numInFlight--;
+			return false;
+		}
+		this->reapCompletions();
+	}
+
+	// Slot for the operation - its index travels through the kernel as the user data
+	int slot = this->addOperation(operation);
+	Operation &queued = this->operations[slot];
+
+	unsigned int tail = *this->sqTail;
+	unsigned int index = tail & *this->sqMask;
+	struct io_uring_sqe *sqe = &((struct io_uring_sqe *) this->sqeMemory)[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->fd = queued.fd;
+	sqe->user_data = slot;
+
+	if (queued.type == OP_SEND) {
+		// The kernel reads the message when the send starts - the slot keeps it (and the parts) until then
+		memset(&queued.message, 0, sizeof(queued.message));
+		queued.message.msg_iov = queued.parts.data();
+		queued.message.msg_iovlen = queued.parts.size();
+
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->addr = (uint64_t) (uintptr_t) &queued.message;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+	} else if (queued.type == OP_RECV) {
+		sqe->opcode = IORING_OP_RECV;
+		sqe->addr = (uint64_t) (uintptr_t) queued.buffer;
+		sqe->len = queued.len;
+		sqe->msg_flags = queued.flags;
+	} else {
+		// Inside the registered buffer? Then the fixed-buffer version of the operation can be used.
+		bool isFixed = this->registeredBuffer != nullptr && queued.buffer >= this->registeredBuffer
+			&& queued.buffer + queued.len <= this->registeredBuffer + this->registeredSize;
+
+		if (queued.type == OP_WRITE) {
+			sqe->opcode = (isFixed) ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		} else {
+			sqe->opcode = (isFixed) ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		}
+		sqe->off = queued.offset;
+		sqe->addr = (uint64_t) (uintptr_t) queued.buffer;
+		sqe->len = queued.len;
+		sqe->buf_index = 0;
+	}
+
+	this->sqArray[index] = index;
+	__atomic_store_n(this->sqTail, tail + 1, __ATOMIC_RELEASE);
+	this->numUnsubmitted++;
+#endif
+
+	return true;
+}
+
+/**
+ * @brief Hand queued operations to the kernel and/or wait for completions
+ *
+ * @return int (operations submitted, or -errno)
+ */
+int AsyncIO::enter(unsigned int toSubmit, unsigned int minComplete) {
+#ifdef ASYNCIO_URING
+	int result;
+	do {
+		result = syscall(__NR_io_uring_enter, this->ringFD, toSubmit, minComplete, (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+		this->numSystemCalls++;
+	} while (result < 0 && errno == EINTR);
+
+	if (result < 0) {
+		return -errno;
+	}
+
+	this->numUnsubmitted -= result;
+	return result;
+#else
+	(void) toSubmit;
+	(void) minComplete;
+	return -ENOSYS;
+#endif
+}
+
+/**
+ * @brief Move finished operations from the completion ring to our list
+ */
+void AsyncIO::reapCompletions() {
+#ifdef ASYNCIO_URING
+	unsigned int head = *this->cqHead;
+	unsigned int tail = __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &((struct io_uring_cqe *) this->cqes)[head & *this->cqMask];
+		Operation &operation = this->operations[cqe->user_data];
+		long long result = cqe->res;
+
+		// Short send (or a non-blocking socket that was full) / short read or write - finish the rest here
+		if (operation.type == OP_SEND) {
+			if ((result >= 0 && (size_t) result < operation.len) || result == -EAGAIN) {
+				result = this->finishSend(operation, max(0LL, result));
+			}
+		} else if (operation.type != OP_RECV && result >= 0 && (size_t) result < operation.len) {
+			result = this->finishSync(operation, result);
+		}
+
+		Completion completion = { operation.tag, result };
+		this->completed.push_back(completion);
+		this->freeOperations.push_back(cqe->user_data);
+
+		head++;
+	}
+
+	__atomic_store_n(this->cqHead, head, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * @brief Do (the rest of) a file operation with pread / pwrite
+ *
+ * @param done Bytes already transferred
+ * @return long long (bytes transferred - less than asked at the end of a file - or -errno)
+ */
+long long AsyncIO::finishSync(Operation &operation, long long done) {
+	while ((size_t) done < operation.len) {
+		ssize_t result;
+		if (operation.type == OP_WRITE) {
+			result = pwrite(operation.fd, operation.buffer + done, operation.len - done, operation.offset + done);
+		} else {
+			result = pread(operation.fd, operation.buffer + done, operation.len - done, operation.offset + done);
+		}
+		this->numSystemCalls++;
+
+		if (result < 0) {
+			if (errno == EINTR) continue;
+			return -errno;
+		}
+
+		// End of the file
+		if (result == 0) {
+			break;
+		}
+
+		done += result;
+	}
+
+	return done;
+}
+
+/**
+ * @brief Send the rest of a message with sendmsg, waiting for room if the socket is full
+ *
+ * @param sent Bytes the kernel sent since operation.done
+ * @return long long (the whole length, or -errno)
+ */
+long long AsyncIO::finishSend(Operation &operation, long long sent) {
+	skipSent(operation.parts, sent);
+	operation.done += sent;
+
+	while (operation.done < operation.len) {
+		struct msghdr message = {};
+		message.msg_iov = operation.parts.data();
+		message.msg_iovlen = operation.parts.size();
+
+		ssize_t result = sendmsg(operation.fd, &message, MSG_NOSIGNAL);
+		this->numSystemCalls++;
+
+		if (result < 0) {
+			if (errno == EINTR) continue;
+
+			// Non-blocking and the socket buffer is full - wait for room.
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				struct pollfd pollSocket = {};
+				pollSocket.fd = operation.fd;
+				pollSocket.events = POLLOUT;
+				poll(&pollSocket, 1, -1);
+				continue;
+			}
+			return -errno;
+		}
+
+		skipSent(operation.parts, result);
+		operation.done += result;
+	}
+
+	return operation.len;
+}
+
+/**
+ * @brief Try a send / receive without waiting (epoll engine)
+ *
+ * @param result Set once the operation is over (bytes, or -errno)
+ * @param isHungUp Has epoll said no more is coming? (a shut down UDP socket says EAGAIN, where a waiting recv() says 0)
+ * @return bool (false = the socket isn't ready - wait for it)
+ */
+bool AsyncIO::trySocket(Operation &operation, long long &result, bool isHungUp) {
+	if (operation.type == OP_SEND) {
+		while (operation.done < operation.len) {
+			struct msghdr message = {};
+			message.msg_iov = operation.parts.data();
+			message.msg_iovlen = operation.parts.size();
+
+			ssize_t sent = sendmsg(operation.fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+			this->numSystemCalls++;
+
+			if (sent < 0) {
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+				result = -errno;
+				return true;
+			}
+
+			skipSent(operation.parts, sent);
+			operation.done += sent;
+		}
+
+		result = operation.len;
+		return true;
+	}
+
+	while (1) {
+		ssize_t received = recv(operation.fd, operation.buffer, operation.len, operation.flags | MSG_DONTWAIT);
+		this->numSystemCalls++;
+
+		if (received >= 0) {
+			result = received;
+			return true;
+		}
+		if (errno == EINTR) continue;
+
+		// Nothing yet - wait for it, unless the caller asked not to (or nothing more can come)
+		if ((errno == EAGAIN || errno == EWOULDBLOCK) && !(operation.flags & MSG_DONTWAIT)) {
+			if (isHungUp) {
+				result = 0;
+				return true;
+			}
+			return false;
+		}
+
+		result = -errno;
+		return true;
+	}
+}
+
+/**
+ * @brief Try the waiting sends / receives again, sleeping in epoll until a socket is ready if asked to
+ *
+ * @param wait Sleep until one of them finishes?
+ * @return bool (false = epoll failed)
+ */
+bool AsyncIO::pollWaiting(bool wait) {
+	set<int> hungUpSockets;	// Reported by the last epoll_wait
+
+	while (!this->waitingOperations.empty()) {
+
+		// Try each again - whatever finishes (or fails) leaves the list
+		size_t numKept = 0;
+		for (size_t i = 0; i < this->waitingOperations.size(); i++) {
+			int slot = this->waitingOperations[i];
+			Operation &operation = this->operations[slot];
+
+			long long result;
+			if (!this->trySocket(operation, result, hungUpSockets.count(operation.fd) > 0)) {
+				this->waitingOperations[numKept++] = slot;
+				continue;
+			}
+
+			Completion completion = { operation.tag, result };
+			this->completed.push_back(completion);
+			this->freeOperations.push_back(slot);
+		}
+		this->waitingOperations.resize(numKept);
+
+		if (!wait || !this->completed.empty() || this->waitingOperations.empty()) {
+			return true;
+		}
+
+		// Watch each socket for what's waiting on it (one shot - re-armed every time we sleep)
+		if (this->epollFD < 0) {
+			this->epollFD = epoll_create1(EPOLL_CLOEXEC);
+			if (this->epollFD < 0) {
+				return false;
+			}
+		}
+
+		map<int, uint32_t> socketEvents;
+		for (size_t i = 0; i < this->waitingOperations.size(); i++) {
+			Operation &operation = this->operations[this->waitingOperations[i]];
+			socketEvents[operation.fd] |= (operation.type == OP_SEND) ? EPOLLOUT : EPOLLIN;
+		}
+
+		for (map<int, uint32_t>::iterator iterator = socketEvents.begin(); iterator != socketEvents.end(); ++iterator) {
+			struct epoll_event event = {};
+			event.events = iterator->second | EPOLLRDHUP | EPOLLONESHOT;
+			event.data.fd = iterator->first;
+
+			if (epoll_ctl(this->epollFD, EPOLL_CTL_MOD, iterator->first, &event) < 0
+					&& (errno != ENOENT || epoll_ctl(this->epollFD, EPOLL_CTL_ADD, iterator->first, &event) < 0)) {
+				return false;
+			}
+		}
+
+		struct epoll_event events[MAX_EPOLL_EVENTS];
+		int numEvents;
+		do {
+			numEvents = epoll_wait(this->epollFD, events, MAX_EPOLL_EVENTS, -1);
+			this->numSystemCalls++;
+		} while (numEvents < 0 && errno == EINTR);
+
+		if (numEvents < 0) {
+			return false;
+		}
+
+		hungUpSockets.clear();
+		for (int i = 0; i < numEvents; i++) {
+			if (events[i].events & (EPOLLRDHUP | EPOLLHUP)) {
+				hungUpSockets.insert(events[i].data.fd);
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Get the next finished operation
+ *
+ * Submits anything queued first, so operations start as soon as the caller looks for results.
+ *
+ * @param wait Block until something finishes?
+ * @return bool (false = nothing finished, or the engine failed)
+ */
+bool AsyncIO::getCompletion(Completion &completion, bool wait) {
+	if (this->engine == ENGINE_IO_URING) {
+		this->reapCompletions();
+
+		bool needWait = wait && this->completed.empty() && this->numInFlight > 0;
+		if (this->numUnsubmitted > 0 || needWait) {
+			if (this->enter(this->numUnsubmitted, (needWait) ? 1 : 0) < 0 && this->completed.empty()) {
+				return false;
+			}
+			this->reapCompletions();
+		}
+	} else if (!this->pollWaiting(wait && this->completed.empty())) {
+		return false;
+	}
+
+	if (this->completed.empty()) {
+		return false;
+	}
+
+	completion = this->completed.front();
+	this->completed.pop_front();
+	this->numInFlight--;
+
+	return true;
+}
+
+/**
+ * @brief Operations submitted whose completion hasn't been handed out yet
+ */
+int AsyncIO::getNumInFlight() {
+	return this->numInFlight;
+}
+
+/**
+ * @brief Number of operations submitted
+ */
+long long AsyncIO::getNumOperations() {
+	return this->numOperations;
+}
+
+/**
+ * @brief Number of system calls made (io_uring_enter, or pread / pwrite / sendmsg / recv / epoll_wait)
+ */
+long long AsyncIO::getNumSystemCalls() {
+	return this->numSystemCalls;
+}
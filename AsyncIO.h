@@ -0,0 +1,139 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+using namespace std;
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+/**
+ * Async I/O
+ *
+ * Runs file reads and writes, and socket sends and receives, in the background so the disk and
+ * 		the network can be busy at the same time. Operations are submitted with a tag and reported
+ * 		back (in any order) by getCompletion().
+ *
+ * Engines:
+ * 		ENGINE_IO_URING - io_uring through the raw system calls. Buffers inside the registered
+ * 						  buffer (the packet pool's arena) use the fixed-buffer operations. Only used
+ * 						  if the kernel says (IORING_REGISTER_PROBE) it has every operation we need.
+ * 		ENGINE_EPOLL    - for kernels without io_uring. Sends and receives are tried right away and,
+ * 						  if the socket isn't ready, wait in epoll until it is. Regular files are
+ * 						  always "ready" (epoll can't wait on them), so they're just pread / pwrite.
+ *
+ * Short reads, writes and sends are finished (pread / pwrite / sendmsg) before the completion is
+ * 		reported. A receive reports whatever arrived, like recv().
+ *
+ * Not thread-safe - use from one thread (or under the caller's lock).
+ */
+class AsyncIO {
+
+	public:
+		static const int ENGINE_EPOLL = 0;
+		static const int ENGINE_IO_URING = 1;
+		static const int MAX_EPOLL_EVENTS = 16;
+
+		// A finished operation
+		struct Completion {
+			uint64_t tag;		// Tag given when it was submitted
+			long long result;	// Bytes transferred (a receive: 0 = the peer closed), or -errno
+		};
+
+	private:
+		static const int OP_READ = 0;
+		static const int OP_WRITE = 1;
+		static const int OP_SEND = 2;
+		static const int OP_RECV = 3;
+
+		// An operation in flight
+		struct Operation {
+			uint64_t tag;
+			int fd;
+			int type;					// OP_X
+			char *buffer;				// Files and receives
+			size_t len;					// Bytes asked for (a send: the whole message)
+			long long offset;			// Files
+			int flags;					// Receives (MSG_X)
+			vector<struct iovec> parts;	// Sends - what's left of the message
+			struct msghdr message;		// Sends (points at parts)
+			size_t done;				// Sends - bytes already sent
+		};
+
+		int engine = ENGINE_EPOLL;
+		int ringFD = -1;
+		unsigned int numEntries = 0;
+
+		// Ring memory (shared with the kernel)
+		void *sqRing = nullptr;
+		void *cqRing = nullptr;
+		void *sqeMemory = nullptr;
+		size_t sqRingSize = 0;
+		size_t cqRingSize = 0;
+		size_t sqeMemorySize = 0;
+		unsigned int *sqHead, *sqTail, *sqMask, *sqArray;
+		unsigned int *cqHead, *cqTail, *cqMask;
+		void *cqes;
+
+		// Registered buffer (fixed-buffer operations)
+		char *registeredBuffer = nullptr;
+		size_t registeredSize = 0;
+
+		deque<Operation> operations;	// Slots for operations in flight (index = io_uring user data) - a deque, so a send's message stays put
+		vector<int> freeOperations;
+		unsigned int numUnsubmitted = 0;	// Queued in the ring but not passed to the kernel yet
+		int numInFlight = 0;
+		deque<Completion> completed;	// Finished, not yet handed out
+
+		// epoll engine - sends / receives waiting for their socket
+		int epollFD = -1;
+		vector<int> waitingOperations;
+
+		// Statistics
+		long long numOperations = 0;
+		long long numSystemCalls = 0;	// io_uring_enter (or pread / pwrite / sendmsg / recv / epoll_wait)
+
+		bool submit(Operation &operation);
+		int addOperation(const Operation &operation);
+		int enter(unsigned int toSubmit, unsigned int minComplete);
+		bool hasOperations();
+		void reapCompletions();
+		long long finishSync(Operation &operation, long long done);
+		long long finishSend(Operation &operation, long long done);
+		bool trySocket(Operation &operation, long long &result, bool isHungUp);
+		bool pollWaiting(bool wait);
+		void closeRing();
+
+	public:
+		AsyncIO();
+		~AsyncIO();
+
+		// Set up the engine (io_uring if the kernel has it)
+		int init(unsigned int queueDepth);
+		int getEngine();
+		static string getEngineName(int engine);
+
+		// Buffer the kernel can use without mapping it on every operation
+		bool registerBuffer(char *buffer, size_t size);
+		bool isBufferRegistered();
+
+		// Files - false = the engine failed (nothing was submitted)
+		bool submitRead(int fd, char *buffer, size_t len, long long offset, uint64_t tag);
+		bool submitWrite(int fd, const char *buffer, size_t len, long long offset, uint64_t tag);
+
+		// Sockets - a whole message (the parts can go once this returns, the data can't) / one receive
+		bool submitSend(int fd, const struct iovec *parts, int numParts, uint64_t tag);
+		bool submitRecv(int fd, char *buffer, size_t len, int flags, uint64_t tag);
+
+		// Next finished operation (false = nothing finished and wait = false, nothing in flight, or the engine failed)
+		bool getCompletion(Completion &completion, bool wait);
+		int getNumInFlight();
+
+		// Statistics
+		long long getNumOperations();
+		long long getNumSystemCalls();
+};
+
+#endif
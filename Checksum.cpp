@@ -0,0 +1,331 @@
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include "Checksum.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHECKSUM_X86 1
+#endif
+using namespace std;
+/**
+ * Checksum
+ *
+ * All kernels add the data as native (little-endian) 32-bit words into a 64-bit total, then fold
+ * 		it down to 16 bits. One's-complement addition doesn't care about byte order, so swapping
+ * 		the folded result gives the same answer as summing big-endian 16-bit words (RFC 1071 2.B).
+ */
+
+/**
+ * @brief Fold a 64-bit running total down to a 16-bit one's-complement sum
+ */
+static uint16_t foldSum(uint64_t sum) {
+	sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+	sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	return (uint16_t) sum;
+}
+
+/**
+ * @brief Add the remaining bytes (less than a vector width) to the running total
+ *
+ * An odd trailing byte is the high byte of a zero padded big-endian word, which is the low
+ * 		byte when we sum in little-endian.
+ */
+static uint64_t sumTail(const unsigned char *data, size_t len, uint64_t sum) {
+	while (len >= 4) {
+		uint32_t word;
+		memcpy(&word, data, sizeof(word));
+		sum += word;
+		data += 4;
+		len -= 4;
+	}
+
+	if (len >= 2) {
+		uint16_t word;
+		memcpy(&word, data, sizeof(word));
+		sum += word;
+		data += 2;
+		len -= 2;
+	}
+
+	if (len == 1) {
+		sum += data[0];
+	}
+
+	return sum;
+}
+
+/**
+ * @brief Finish the checksum from the running total
+ */
+static u_short finishSum(uint64_t sum) {
+	uint16_t folded = foldSum(sum);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	folded = (uint16_t) ((folded >> 8) | (folded << 8));
+#endif
+
+	return (u_short) ~folded;
+}
+
+/**
+ * @brief Scalar kernel - 8 bytes per step
+ */
+static uint64_t sumScalar(const unsigned char *data, size_t len) {
+	uint64_t sum = 0;
+
+	while (len >= 8) {
+		uint64_t word;
+		memcpy(&word, data, sizeof(word));
+		sum += (word & 0xFFFFFFFF) + (word >> 32);
+		data += 8;
+		len -= 8;
+	}
+
+	return sumTail(data, len, sum);
+}
+
+#ifdef CHECKSUM_X86
+/**
+ * @brief SSE2 kernel - 16 bytes per step, widening 32-bit words into two 64-bit lanes
+ */
+__attribute__((target("sse2")))
+static uint64_t sumSSE2(const unsigned char *data, size_t len) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i acc = _mm_setzero_si128();
+
+	while (len >= 16) {
+		__m128i block = _mm_loadu_si128((const __m128i *) data);
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(block, zero));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(block, zero));
+		data += 16;
+		len -= 16;
+	}
+
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i *) lanes, acc);
+
+	return sumTail(data, len, lanes[0] + lanes[1]);
+}
+
+/**
+ * @brief AVX2 kernel - 32 bytes per step, widening 32-bit words into four 64-bit lanes
+ */
+__attribute__((target("avx2")))
+static uint64_t sumAVX2(const unsigned char *data, size_t len) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i acc = _mm256_setzero_si256();
+
+	while (len >= 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i *) data);
+		acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(block, zero));
+		acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(block, zero));
+		data += 32;
+		len -= 32;
+	}
+
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, acc);
+
+	return sumTail(data, len, lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+#endif
+
+/**
+ * @brief CRC-32C lookup table (reflected polynomial 0x82F63B78)
+ */
+struct CrcTable {
+	uint32_t entries[256];
+
+	CrcTable() {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1);
+			}
+			entries[i] = crc;
+		}
+	}
+};
+
+/**
+ * @brief The lookup table, built on first use
+ */
+static const uint32_t *crcTable() {
+	static const CrcTable table;
+	return table.entries;
+}
+
+/**
+ * @brief Table kernel - one byte per step
+ */
+static uint32_t crcTableKernel(const unsigned char *data, size_t len) {
+	const uint32_t *table = crcTable();
+	uint32_t crc = 0xFFFFFFFF;
+
+	while (len--) {
+		crc = table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+#ifdef CHECKSUM_X86
+/**
+ * @brief SSE4.2 kernel - the crc32 instruction, 8 bytes per step
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crcSSE42(const unsigned char *data, size_t len) {
+#ifdef __x86_64__
+	uint64_t crc = 0xFFFFFFFF;
+
+	while (len >= 8) {
+		uint64_t word;
+		memcpy(&word, data, sizeof(word));
+		crc = _mm_crc32_u64(crc, word);
+		data += 8;
+		len -= 8;
+	}
+#else
+	uint32_t crc = 0xFFFFFFFF;
+#endif
+
+	while (len--) {
+		crc = _mm_crc32_u8((uint32_t) crc, *data++);
+	}
+
+	return ~((uint32_t) crc);
+}
+#endif
+
+/**
+ * @brief Is the kernel usable on this CPU?
+ */
+bool Checksum::isKernelSupported(int kernel) {
+	switch (kernel) {
+		case KERNEL_SCALAR:
+		case KERNEL_TABLE:
+			return true;
+#ifdef CHECKSUM_X86
+		case KERNEL_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case KERNEL_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case KERNEL_SSE42:
+			return __builtin_cpu_supports("sse4.2");
+#endif
+		default:
+			return false;
+	}
+}
+
+/**
+ * @brief The best kernel for this CPU (determined once)
+ */
+int Checksum::getKernel() {
+	static int bestKernel = isKernelSupported(KERNEL_AVX2) ? KERNEL_AVX2
+		: (isKernelSupported(KERNEL_SSE2) ? KERNEL_SSE2 : KERNEL_SCALAR);
+
+	return bestKernel;
+}
+
+/**
+ * @brief The best CRC-32C kernel for this CPU (determined once)
+ */
+int Checksum::getCrcKernel() {
+	static int bestKernel = isKernelSupported(KERNEL_SSE42) ? KERNEL_SSE42 : KERNEL_TABLE;
+
+	return bestKernel;
+}
+
+/**
+ * @brief Readable kernel name (for statistics)
+ */
+string Checksum::getKernelName(int kernel) {
+	switch (kernel) {
+		case KERNEL_SSE2:
+			return "SSE2";
+		case KERNEL_AVX2:
+			return "AVX2";
+		case KERNEL_SSE42:
+			return "SSE4.2";
+		case KERNEL_TABLE:
+			return "Table";
+		default:
+			return "Scalar";
+	}
+}
+
+/**
+ * @brief RFC 1071 checksum using the best kernel
+ */
+u_short Checksum::internet(const char *data, size_t len) {
+	return internet(data, len, getKernel());
+}
+
+/**
+ * @brief RFC 1071 checksum using a specific kernel
+ */
+u_short Checksum::internet(const char *data, size_t len, int kernel) {
+	const unsigned char *bytes = (const unsigned char *) data;
+
+	if (!isKernelSupported(kernel)) {
+		kernel = KERNEL_SCALAR;
+	}
+
+#ifdef CHECKSUM_X86
+	if (kernel == KERNEL_AVX2) {
+		return finishSum(sumAVX2(bytes, len));
+	} else if (kernel == KERNEL_SSE2) {
+		return finishSum(sumSSE2(bytes, len));
+	}
+#endif
+
+	return finishSum(sumScalar(bytes, len));
+}
+
+/**
+ * @brief Per-byte checksum matching the original implementation
+ *
+ * The original widened each (signed) char to 16 bits, so bytes >= 0x80 count as 0xFF00 + byte.
+ * 		Summing the bytes and the high-bit count separately gives the same one's-complement total
+ * 		without the per-byte carry check.
+ */
+u_short Checksum::legacy(const char *data, size_t len) {
+	const unsigned char *bytes = (const unsigned char *) data;
+	uint64_t sum = 0;
+	uint64_t numHighBytes = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		sum += bytes[i];
+		numHighBytes += bytes[i] >> 7;
+	}
+
+	sum += numHighBytes * 0xFF00;
+
+	return (u_short) ~foldSum(sum);
+}
+
+/**
+ * @brief CRC-32C using the best kernel
+ */
+uint32_t Checksum::crc32c(const char *data, size_t len) {
+	return crc32c(data, len, getCrcKernel());
+}
+
+/**
+ * @brief CRC-32C using a specific kernel
+ */
+uint32_t Checksum::crc32c(const char *data, size_t len, int kernel) {
+	const unsigned char *bytes = (const unsigned char *) data;
+
+#ifdef CHECKSUM_X86
+	if (kernel == KERNEL_SSE42 && isKernelSupported(KERNEL_SSE42)) {
+		return crcSSE42(bytes, len);
+	}
+#endif
+
+	return crcTableKernel(bytes, len);
+}
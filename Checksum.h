@@ -0,0 +1,50 @@
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+#include <sys/types.h>
+using namespace std;
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+/**
+ * Checksum
+ *
+ * Integrity checks over packet data.
+ * 		internet() - RFC 1071 sum of 16-bit words (used with the binary header)
+ * 		legacy()   - The original per-byte sum (used with the ASCII header for compatibility)
+ * 		crc32c()   - CRC-32C (Castagnoli), the stronger integrity option for the binary header
+ *
+ * The RFC 1071 and CRC-32C kernels are picked once at runtime based on what the CPU supports.
+ */
+class Checksum {
+
+	public:
+		static const int KERNEL_SCALAR = 0;
+		static const int KERNEL_SSE2 = 1;
+		static const int KERNEL_AVX2 = 2;
+		static const int KERNEL_SSE42 = 3;	// CRC-32C instruction
+		static const int KERNEL_TABLE = 4;	// CRC-32C lookup table
+
+		// RFC 1071 checksum with the best available kernel
+		static u_short internet(const char *data, size_t len);
+
+		// RFC 1071 checksum with a specific kernel (falls back to scalar if unsupported)
+		static u_short internet(const char *data, size_t len, int kernel);
+
+		// Per-byte checksum matching the original Packet::createChecksum()
+		static u_short legacy(const char *data, size_t len);
+
+		// CRC-32C with the best available kernel
+		static uint32_t crc32c(const char *data, size_t len);
+
+		// CRC-32C with a specific kernel (falls back to the table if unsupported)
+		static uint32_t crc32c(const char *data, size_t len, int kernel);
+
+		// Kernel details
+		static int getKernel();
+		static int getCrcKernel();
+		static bool isKernelSupported(int kernel);
+		static string getKernelName(int kernel);
+};
+
+#endif
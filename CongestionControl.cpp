@@ -0,0 +1,390 @@
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "CongestionControl.h"
+using namespace std;
+
+constexpr double CubicControl::C;
+constexpr double CubicControl::BETA;
+constexpr double CongestionControl::SLOW_START_PACING_GAIN;
+constexpr double CongestionControl::PACING_GAIN;
+constexpr double BbrControl::WINDOW_GAIN;
+constexpr double BbrControl::PACED_WINDOW_GAIN;
+constexpr double BbrControl::STARTUP_GAIN;
+const double BbrControl::CYCLE_GAINS[8] = { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+/**
+ * @brief Start with the initial window (or the user's, if it's smaller) in slow start
+ */
+CongestionControl::CongestionControl(int maxWindow) {
+	this->maxWindow = max(1, maxWindow);
+	this->slowStartThreshold = this->maxWindow;
+	this->window = min((int) INITIAL_WINDOW, this->maxWindow);
+}
+
+CongestionControl::~CongestionControl() {
+}
+
+/**
+ * @brief Controller by name
+ *
+ * @return unique_ptr<CongestionControl> (nullptr = no congestion control, e.g. "None")
+ */
+unique_ptr<CongestionControl> CongestionControl::create(const string &name, int maxWindow) {
+	if (name == "AIMD") {
+		return unique_ptr<CongestionControl>(new AimdControl(maxWindow));
+	} else if (name == "CUBIC") {
+		return unique_ptr<CongestionControl>(new CubicControl(maxWindow));
+	} else if (name == "BBR") {
+		return unique_ptr<CongestionControl>(new BbrControl(maxWindow));
+	}
+	return nullptr;
+}
+
+/**
+ * @brief Keep the window between 1 packet and the user's window
+ */
+void CongestionControl::clampWindow() {
+	this->window = max(1.0, min(this->window, (double) this->maxWindow));
+}
+
+/**
+ * @brief Is this loss a new congestion event?
+ *
+ * Losses within a round trip of the last reduction come from the same one - the window is only
+ * 		cut once for them.
+ */
+bool CongestionControl::isNewLossEvent(chrono::steady_clock::time_point now) {
+	if (this->numLossEvents > 0 && chrono::duration<double, micro>(now - this->lastReductionTimePoint).count() < this->smoothedRttUS) {
+		return false;
+	}
+
+	this->lastReductionTimePoint = now;
+	this->numLossEvents++;
+	return true;
+}
+
+/**
+ * @brief A packet was ACK'd (the controllers grow the window from here)
+ */
+void CongestionControl::onAck(chrono::steady_clock::time_point) {
+	int curWindow = this->getWindow();
+	this->numAcks++;
+	this->windowTotal += curWindow;
+	this->maxWindowUsed = max(this->maxWindowUsed, curWindow);
+}
+
+/**
+ * @brief A round trip was measured
+ *
+ * Keeps a smoothed round trip (1/8 per sample) and the minimum - which is only trusted for
+ * 		MIN_RTT_WINDOW_MS, in case the path changed.
+ */
+void CongestionControl::onRoundTrip(long long rttUS, chrono::steady_clock::time_point now) {
+	if (this->minRttUS == 0) {
+		this->smoothedRttUS = rttUS;
+	} else {
+		this->smoothedRttUS += (rttUS - this->smoothedRttUS) / 8;
+	}
+
+	if (this->minRttUS == 0 || rttUS <= this->minRttUS || now - this->minRttTimePoint > chrono::milliseconds((long long) MIN_RTT_WINDOW_MS)) {
+		this->minRttUS = max(1LL, rttUS);
+		this->minRttTimePoint = now;
+	}
+}
+
+/**
+ * @brief A packet was lost (the controllers shrink the window from here)
+ */
+void CongestionControl::onLoss(chrono::steady_clock::time_point, bool isTimeout) {
+	if (isTimeout) {
+		this->numTimeouts++;
+	}
+}
+
+/**
+ * @brief Packets allowed in flight
+ */
+int CongestionControl::getWindow() {
+	return max(1, min(this->maxWindow, (int) this->window));
+}
+
+/**
+ * @brief Packets are (or aren't) paced at getPacingRate()
+ */
+void CongestionControl::setPaced(bool isPaced) {
+	this->isPaced = isPaced;
+}
+
+/**
+ * @brief Rate to pace packets at (packets per second, 0 = no round trip yet)
+ *
+ * A window per round trip - twice that in slow start, so the pacing doesn't hold the doubling
+ * 		back, and a bit more after it (as Linux does).
+ */
+double CongestionControl::getPacingRate() {
+	if (this->smoothedRttUS <= 0) {
+		return 0;
+	}
+
+	double gain = (this->window < this->slowStartThreshold) ? SLOW_START_PACING_GAIN : PACING_GAIN;
+	return gain * this->getWindow() / this->smoothedRttUS * 1000000;
+}
+
+/**
+ * @brief Average window over every ACK
+ */
+double CongestionControl::getAverageWindow() {
+	return (this->numAcks > 0) ? this->windowTotal / this->numAcks : this->getWindow();
+}
+
+/**
+ * @brief Biggest window we got to
+ */
+int CongestionControl::getMaxWindowUsed() {
+	return this->maxWindowUsed;
+}
+
+/**
+ * @brief Number of times the window was cut
+ */
+long long CongestionControl::getNumLossEvents() {
+	return this->numLossEvents;
+}
+
+/**
+ * @brief Number of losses found by a retransmission timeout
+ */
+long long CongestionControl::getNumTimeouts() {
+	return this->numTimeouts;
+}
+
+/**
+ * @brief AIMD (starts in slow start)
+ */
+AimdControl::AimdControl(int maxWindow) : CongestionControl(maxWindow) {
+}
+
+string AimdControl::getName() {
+	return "AIMD";
+}
+
+/**
+ * @brief +1 per ACK in slow start (doubles every round trip), +1/window after that (+1 every round trip)
+ */
+void AimdControl::onAck(chrono::steady_clock::time_point now) {
+	CongestionControl::onAck(now);
+
+	if (this->window < this->slowStartThreshold) {
+		this->window += 1;
+	} else {
+		this->window += 1 / this->window;
+	}
+	this->clampWindow();
+}
+
+/**
+ * @brief Halve the window once per congestion event - a timeout starts over from 1 (in slow start)
+ */
+void AimdControl::onLoss(chrono::steady_clock::time_point now, bool isTimeout) {
+	CongestionControl::onLoss(now, isTimeout);
+
+	if (this->isNewLossEvent(now)) {
+		this->slowStartThreshold = max((double) MIN_WINDOW, this->window / 2);
+	}
+	this->window = (isTimeout) ? 1 : min(this->window, this->slowStartThreshold);
+	this->clampWindow();
+}
+
+/**
+ * @brief CUBIC (starts in slow start, like AIMD)
+ */
+CubicControl::CubicControl(int maxWindow) : CongestionControl(maxWindow) {
+}
+
+string CubicControl::getName() {
+	return "CUBIC";
+}
+
+/**
+ * @brief Grow towards the cubic curve
+ *
+ * W(t) = C * (t - K)^3 + origin, where t is the time since congestion avoidance started. Each ACK
+ * 		closes 1/window of the gap to where the curve will be a round trip from now, and never
+ * 		grows slower than AIMD would (the TCP-friendly region).
+ */
+void CubicControl::onAck(chrono::steady_clock::time_point now) {
+	CongestionControl::onAck(now);
+
+	// Slow start
+	if (this->window < this->slowStartThreshold) {
+		this->window += 1;
+		this->clampWindow();
+		return;
+	}
+
+	// First ACK since the loss? The curve starts here.
+	if (!this->hasEpoch) {
+		this->hasEpoch = true;
+		this->epochTimePoint = now;
+		this->renoWindow = this->window;
+
+		if (this->window < this->lastMaxWindow) {
+			this->cubicK = cbrt((this->lastMaxWindow - this->window) / C);
+			this->originWindow = this->lastMaxWindow;
+		} else {
+			this->cubicK = 0;
+			this->originWindow = this->window;
+		}
+	}
+
+	double seconds = chrono::duration<double>(now - this->epochTimePoint).count() + this->minRttUS / 1000000;
+	double targetWindow = this->originWindow + C * pow(seconds - this->cubicK, 3);
+
+	// TCP-friendly - at least what AIMD (with the same average window) would have
+	this->renoWindow += 3 * (1 - BETA) / (1 + BETA) / this->window;
+	targetWindow = max(targetWindow, this->renoWindow);
+
+	// At most 1.5x per round trip
+	targetWindow = min(targetWindow, this->window * 1.5);
+
+	if (targetWindow > this->window) {
+		this->window += (targetWindow - this->window) / this->window;
+	} else {
+		this->window += 0.01 / this->window;
+	}
+	this->clampWindow();
+}
+
+/**
+ * @brief Keep BETA of the window and remember where we lost (a timeout starts over from 1)
+ *
+ * Lost again below the last peak? Then some other flow is taking the bandwidth - settle a bit
+ * 		lower than where we lost (fast convergence).
+ */
+void CubicControl::onLoss(chrono::steady_clock::time_point now, bool isTimeout) {
+	CongestionControl::onLoss(now, isTimeout);
+
+	if (this->isNewLossEvent(now)) {
+		this->lastMaxWindow = (this->window < this->lastMaxWindow) ? this->window * (1 + BETA) / 2 : this->window;
+		this->slowStartThreshold = max((double) MIN_WINDOW, this->window * BETA);
+		this->hasEpoch = false;
+	}
+	this->window = (isTimeout) ? 1 : min(this->window, this->slowStartThreshold);
+	this->clampWindow();
+}
+
+/**
+ * @brief BBR (starts in startup)
+ */
+BbrControl::BbrControl(int maxWindow) : CongestionControl(maxWindow) {
+}
+
+string BbrControl::getName() {
+	return "BBR";
+}
+
+/**
+ * @brief Bottleneck bandwidth - the best delivery rate of the last rounds (packets / us)
+ */
+double BbrControl::getMaxRate() {
+	double maxRate = 0;
+	for (int i = 0; i < BANDWIDTH_ROUNDS; i++) {
+		maxRate = max(maxRate, this->roundRates[i]);
+	}
+	return maxRate;
+}
+
+/**
+ * @brief A round trip's worth of ACKs came in - take its delivery rate
+ */
+void BbrControl::endRound(chrono::steady_clock::time_point now) {
+	double elapsedUS = chrono::duration<double, micro>(now - this->roundTimePoint).count();
+	if (elapsedUS > 0) {
+		this->roundRates[this->roundNum % BANDWIDTH_ROUNDS] = (this->numDelivered - this->roundStartDelivered) / elapsedUS;
+	}
+	this->roundNum++;
+	this->roundStartDelivered = this->numDelivered;
+	this->roundTimePoint = now;
+
+	// Startup - keep going while the rate grows 25% a round. Three rounds without? The pipe is full.
+	this->isDrain = false;
+	if (this->isStartup) {
+		double maxRate = this->getMaxRate();
+		if (maxRate >= this->fullRate * 1.25) {
+			this->fullRate = maxRate;
+			this->numFlatRounds = 0;
+		} else if (++this->numFlatRounds >= 3) {
+			this->isStartup = false;
+			this->isDrain = true;
+		}
+	}
+}
+
+/**
+ * @brief Count the delivery and follow the model
+ */
+void BbrControl::onAck(chrono::steady_clock::time_point now) {
+	CongestionControl::onAck(now);
+	this->numDelivered++;
+
+	// A round lasts a round trip
+	if (!this->hasRound) {
+		this->hasRound = true;
+		this->roundTimePoint = now;
+		this->roundStartDelivered = this->numDelivered;
+	} else if (this->smoothedRttUS > 0 && chrono::duration<double, micro>(now - this->roundTimePoint).count() >= this->smoothedRttUS) {
+		this->endRound(now);
+	}
+
+	// Startup - double every round trip (like slow start)
+	if (this->isStartup) {
+		this->window += 1;
+		this->clampWindow();
+		return;
+	}
+
+	double bdp = this->getMaxRate() * this->minRttUS;
+	if (this->isPaced) {
+		this->window = max((double) MIN_BBR_WINDOW, PACED_WINDOW_GAIN * bdp);
+	} else {
+		this->window = max((double) MIN_BBR_WINDOW, WINDOW_GAIN * CYCLE_GAINS[this->roundNum % 8] * bdp);
+	}
+	this->clampWindow();
+}
+
+/**
+ * @brief Losses alone don't change the model - a timeout (nothing getting through) holds the
+ * 		window down until the next ACK
+ */
+void BbrControl::onLoss(chrono::steady_clock::time_point now, bool isTimeout) {
+	CongestionControl::onLoss(now, isTimeout);
+
+	this->isNewLossEvent(now);
+	if (isTimeout) {
+		this->window = MIN_BBR_WINDOW;
+		this->clampWindow();
+	}
+}
+
+/**
+ * @brief Pace at the max delivery rate x the gain for where we are (startup, drain, or the probe cycle)
+ *
+ * No rate measured yet? Then it's a window per round trip, like the others.
+ */
+double BbrControl::getPacingRate() {
+	double maxRate = this->getMaxRate();
+	if (maxRate <= 0) {
+		return CongestionControl::getPacingRate();
+	}
+
+	double gain = CYCLE_GAINS[this->roundNum % 8];
+	if (this->isStartup) {
+		gain = STARTUP_GAIN;
+	} else if (this->isDrain) {
+		gain = 1 / STARTUP_GAIN;
+	}
+	return gain * maxRate * 1000000;
+}
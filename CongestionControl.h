@@ -0,0 +1,172 @@
+#include <string>
+#include <memory>
+#include <chrono>
+using namespace std;
+#ifndef CONGESTIONCONTROL_H
+#define CONGESTIONCONTROL_H
+
+/**
+ * Congestion Control
+ *
+ * Decides how many packets the sender can have in flight (the congestion window) from what the
+ * 		ACKs tell us: packets delivered, round trip times and losses. The sliding window the
+ * 		user picked stays the upper bound.
+ *
+ * Controllers (see create()):
+ * 		AIMD  - Reno style: slow start, then +1 packet per round trip, cut in half on a loss
+ * 		CUBIC - grows along a cubic curve centred on the window it last lost at (RFC 8312)
+ * 		BBR   - model based: follows the measured bottleneck bandwidth x minimum round trip,
+ * 				and mostly ignores losses
+ *
+ * Each one also gives a rate to pace packets at (see Pacer), so a window that opens up doesn't
+ * 		leave as one burst.
+ *
+ * Not thread-safe - use from one thread (or under the caller's lock).
+ */
+class CongestionControl {
+
+	public:
+		static const int INITIAL_WINDOW = 10;	// Packets (RFC 6928)
+		static const int MIN_WINDOW = 2;		// After a loss (a timeout drops to 1)
+		static const int MIN_RTT_WINDOW_MS = 10000;	// How long the minimum round trip is trusted
+		static constexpr double SLOW_START_PACING_GAIN = 2.0;	// Pacing rate = gain x window / round trip
+		static constexpr double PACING_GAIN = 1.2;
+
+	protected:
+		double window = INITIAL_WINDOW;		// Congestion window (packets)
+		double slowStartThreshold;			// Slow start below this
+		int maxWindow;						// The user's sliding window
+		bool isPaced = false;				// Are the packets paced? (see setPaced())
+
+		// Round trips
+		double smoothedRttUS = 0;
+		double minRttUS = 0;				// 0 = no samples yet
+		chrono::steady_clock::time_point minRttTimePoint;	// When the minimum was taken
+		chrono::steady_clock::time_point lastReductionTimePoint;
+
+		// Statistics
+		long long numAcks = 0;
+		double windowTotal = 0;				// Window at every ACK (for the average)
+		int maxWindowUsed = 0;
+		long long numLossEvents = 0;
+		long long numTimeouts = 0;
+
+		bool isNewLossEvent(chrono::steady_clock::time_point now);
+		void clampWindow();
+
+	public:
+		CongestionControl(int maxWindow);
+		virtual ~CongestionControl();
+
+		// Controller by name ("AIMD", "CUBIC" or "BBR" - nullptr for anything else, e.g. "None")
+		static unique_ptr<CongestionControl> create(const string &name, int maxWindow);
+
+		virtual string getName() = 0;
+
+		// A packet was ACK'd / a round trip was measured (only packets sent once - Karn's rule)
+		virtual void onAck(chrono::steady_clock::time_point now);
+		virtual void onRoundTrip(long long rttUS, chrono::steady_clock::time_point now);
+
+		// A packet was lost - its retransmission timer went off, or later packets show it's missing
+		virtual void onLoss(chrono::steady_clock::time_point now, bool isTimeout);
+
+		// Packets allowed in flight (1 to the user's window)
+		int getWindow();
+
+		// Packets are paced at getPacingRate() - packets per second (0 = no round trip yet)
+		virtual void setPaced(bool isPaced);
+		virtual double getPacingRate();
+
+		// Statistics
+		double getAverageWindow();
+		int getMaxWindowUsed();
+		long long getNumLossEvents();
+		long long getNumTimeouts();
+};
+
+/**
+ * Reno style AIMD - additive increase (+1 packet per round trip), multiplicative decrease (x1/2)
+ */
+class AimdControl : public CongestionControl {
+
+	public:
+		AimdControl(int maxWindow);
+
+		string getName();
+		void onAck(chrono::steady_clock::time_point now);
+		void onLoss(chrono::steady_clock::time_point now, bool isTimeout);
+};
+
+/**
+ * CUBIC - after a loss, the window climbs quickly back towards where it was, levels off there,
+ * 		then probes further. Growth depends on time since the loss, not on round trips.
+ */
+class CubicControl : public CongestionControl {
+
+	public:
+		static constexpr double C = 0.4;		// Scaling (packets / s^3)
+		static constexpr double BETA = 0.7;		// Window kept after a loss
+
+	private:
+		double lastMaxWindow = 0;				// Window at the last loss (W_max)
+		double originWindow = 0;				// Where the curve levels off
+		double renoWindow = 0;					// What AIMD would have by now (TCP-friendly region)
+		double cubicK = 0;						// Seconds to climb back to the origin
+		bool hasEpoch = false;					// Congestion avoidance started since the last loss?
+		chrono::steady_clock::time_point epochTimePoint;
+
+	public:
+		CubicControl(int maxWindow);
+
+		string getName();
+		void onAck(chrono::steady_clock::time_point now);
+		void onLoss(chrono::steady_clock::time_point now, bool isTimeout);
+};
+
+/**
+ * BBR style - measures the delivery rate each round trip and keeps the window at a multiple of
+ * 		the bandwidth-delay product (max delivery rate over the last rounds x minimum round trip).
+ *
+ * Startup doubles the window every round trip until the delivery rate stops growing. After that
+ * 		the window cycles through a round a bit above the BDP (probing for more bandwidth), one a bit
+ * 		below (draining any queue that built up) and six at it.
+ *
+ * Paced, the cycle moves to the pacing rate instead (gain x max delivery rate) and the window is
+ * 		just a cap at PACED_WINDOW_GAIN x BDP - the rate keeps the queue down. Startup is followed by
+ * 		a round paced at 1 / STARTUP_GAIN, to drain the queue it built.
+ */
+class BbrControl : public CongestionControl {
+
+	public:
+		static const int BANDWIDTH_ROUNDS = 10;		// Rounds the max delivery rate is taken over
+		static const int MIN_BBR_WINDOW = 4;
+		static constexpr double WINDOW_GAIN = 1.0;	// Window = gain x BDP (not paced - anything more is a standing queue)
+		static constexpr double PACED_WINDOW_GAIN = 2.0;
+		static constexpr double STARTUP_GAIN = 2.885;	// 2/ln(2) - doubles the delivery rate every round trip
+		static const double CYCLE_GAINS[8];			// Probe, drain, then six rounds at the BDP
+
+	private:
+		bool isStartup = true;
+		bool isDrain = false;						// The round after startup (paced) - drain the queue startup built
+		double roundRates[BANDWIDTH_ROUNDS] = {};	// Delivery rate of the last rounds (packets / us)
+		int roundNum = 0;
+		long long numDelivered = 0;
+		long long roundStartDelivered = 0;
+		chrono::steady_clock::time_point roundTimePoint;	// When the current round started
+		bool hasRound = false;
+		double fullRate = 0;						// Startup: best rate so far
+		int numFlatRounds = 0;						// Startup: rounds without 25% more
+
+		double getMaxRate();
+		void endRound(chrono::steady_clock::time_point now);
+
+	public:
+		BbrControl(int maxWindow);
+
+		string getName();
+		void onAck(chrono::steady_clock::time_point now);
+		void onLoss(chrono::steady_clock::time_point now, bool isTimeout);
+		double getPacingRate();
+};
+
+#endif
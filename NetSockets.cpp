@@ -4,6 +4,12 @@
 #include <string>
 #include <vector>
 #include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <sys/uio.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
 #include "NetSockets.h"
 using namespace std;
@@ -37,9 +43,39 @@ int NetSocket::getType() {
 	return this->socketType;
 }
 
+/**
+ * @brief Set the transport
+ * 
+ * The transports are based on constants: NetSocket::TRANSPORT_X
+ * 		Must be called before the socket is created.
+ * 
+ * @param transport 
+ */
+void NetSocket::setTransport(int transport) {
+	this->transport = transport;
+}
+
+/**
+ * @brief The transport
+ * 
+ * @return int 
+ */
+int NetSocket::getTransport() {
+	return this->transport;
+}
+
+/**
+ * @brief Readable transport name
+ */
+string NetSocket::getTransportName(int transport) {
+	return (transport == NetSocket::TRANSPORT_UDP) ? "UDP" : "TCP";
+}
+
 /**
  * Create a listening socket for the server
  * 
+ * With UDP there is no connection to accept - we wait for the first datagram and then only talk to
+ * 		whoever sent it.
  */
 bool NetSocket::createServerSocket(int usePort) {
 	// Set the type
@@ -48,7 +84,7 @@ bool NetSocket::createServerSocket(int usePort) {
 	cout << "Create Socket\n";
 
 	// Create the socket file descripter
-	srv_file_desc = socket(AF_INET, SOCK_STREAM, 0);
+	srv_file_desc = socket(AF_INET, (this->transport == NetSocket::TRANSPORT_UDP) ? SOCK_DGRAM : SOCK_STREAM, 0);
 
 	// Did the socket fail?
 	if (!srv_file_desc) {
@@ -78,6 +114,23 @@ bool NetSocket::createServerSocket(int usePort) {
 		return false;
 	}
 
+	// UDP - peek at the first datagram to find the sender, then connect so we only receive from (and send to) them
+	if (this->transport == NetSocket::TRANSPORT_UDP) {
+		cout << "Awaiting Datagrams on port: " << usePort << "\n";
+
+		char firstByte;
+		if (recvfrom(srv_file_desc, &firstByte, sizeof(firstByte), MSG_PEEK, (struct sockaddr *)&address, (socklen_t*)&addrlen) < 0
+				|| connect(srv_file_desc, (struct sockaddr *)&address, sizeof(address)) < 0) {
+			cout << "Connect Failed\n";
+			return false;
+		}
+		client_socket = srv_file_desc;
+
+		printf("Client connected from %s on port %d\n", inet_ntoa(address.sin_addr), ntohs(address.sin_port));
+
+		return true;
+	}
+
 	cout << "Create Listener\n";
 
 	// Create a listener for connections
@@ -94,6 +147,118 @@ bool NetSocket::createServerSocket(int usePort) {
 	return true;
 }
 
+/**
+ * Create a listening socket for a server that takes many connections (TCP)
+ * 
+ * Unlike createServerSocket() this doesn't wait for anyone - connections are taken with acceptConnection().
+ */
+bool NetSocket::createListenSocket(int usePort, int backlog) {
+	// Set the type
+	this->setType(NetSocket::TYPE_SERVER);
+
+	cout << "Create Socket\n";
+
+	// Create the socket file descripter
+	srv_file_desc = socket(AF_INET, SOCK_STREAM, 0);
+
+	// Did the socket fail?
+	if (srv_file_desc < 0) {
+		cout << "Socket Failed\n";
+		return false;
+	}
+
+	int opt = 1;
+
+	cout << "Attach Socket To Port\n";
+
+	// Attach the socket to a port
+	if (setsockopt(srv_file_desc, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+		cout << "SetSockOpt Failed\n";
+		return false;
+	}
+
+	// Set the address information
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = INADDR_ANY;
+	address.sin_port = htons( usePort );
+
+	// Bind the socket to the port
+	if (::bind (srv_file_desc, (struct sockaddr *)&address, sizeof(address)) < 0) {
+		cout << "Bind Failed\n";
+		return false;
+	}
+
+	cout << "Create Listener\n";
+
+	// Create a listener for connections
+	if (listen(srv_file_desc, backlog) < 0) {
+		cout << "Listen Failed\n";
+		return false;
+	}
+
+	cout << "Awaiting Connections on port: " << usePort << "\n";
+
+	return true;
+}
+
+/**
+ * @brief Wait for the next connection on a listening socket (see createListenSocket())
+ * 
+ * @param connection Set up as the server side of the new connection
+ * @return bool (false = accept failed)
+ */
+bool NetSocket::acceptConnection(NetSocket &connection) {
+	int addrlen = sizeof(connection.address);
+
+	int newSocket;
+	do {
+		newSocket = accept(srv_file_desc, (struct sockaddr *)&connection.address, (socklen_t*)&addrlen);
+	} while (newSocket < 0 && errno == EINTR);
+
+	if (newSocket < 0) {
+		cout << "Accept Failed\n";
+		return false;
+	}
+
+	connection.setType(NetSocket::TYPE_SERVER);
+	connection.setTransport(this->transport);
+	connection.client_socket = newSocket;
+
+	// Show a connection message
+	printf("Client connected from %s on port %d\n", inet_ntoa(connection.address.sin_addr), ntohs(connection.address.sin_port));
+
+	return true;
+}
+
+/**
+ * @brief Make reads return straight away when there is nothing to read
+ * 
+ * getFrame() then returns false with wouldBlock() set instead of waiting. Sends still finish every frame.
+ * 
+ * @return bool 
+ */
+bool NetSocket::setNonBlocking() {
+	int socketToUse = this->getSocketToUse();
+	int flags = fcntl(socketToUse, F_GETFL, 0);
+
+	this->nonBlocking = flags >= 0 && fcntl(socketToUse, F_SETFL, flags | O_NONBLOCK) == 0;
+	return this->nonBlocking;
+}
+
+/**
+ * @brief Do reads return right away when nothing has arrived? (see setNonBlocking())
+ */
+bool NetSocket::isNonBlocking() {
+	return this->nonBlocking;
+}
+
+/**
+ * @brief The file descriptor we send and receive on (for poll / epoll)
+ */
+int NetSocket::getFileDescriptor() {
+	return this->getSocketToUse();
+}
+
 /**
  * Create a client socket
  */
@@ -102,7 +267,7 @@ bool NetSocket::createClientSocket(string serverIp, int usePort) {
 	this->setType(NetSocket::TYPE_CLIENT);
 
 	// Create the socket file descripter
-	srv_file_desc = socket(AF_INET, SOCK_STREAM, 0);
+	srv_file_desc = socket(AF_INET, (this->transport == NetSocket::TRANSPORT_UDP) ? SOCK_DGRAM : SOCK_STREAM, 0);
 
 	address.sin_family = AF_INET;
     address.sin_port = htons(usePort);
@@ -111,7 +276,7 @@ bool NetSocket::createClientSocket(string serverIp, int usePort) {
 
 	printf("Connecting to %s on port %d\n", serverIp.c_str(), usePort);
 
-	// Connect to the IP
+	// Connect to the IP (for UDP this just sets where our datagrams go)
 	if (connect(srv_file_desc, (struct sockaddr *)&address, sizeof(address)) < 0) {
 		cout << "Connection Failed\n";
 		return false;
@@ -120,73 +285,694 @@ bool NetSocket::createClientSocket(string serverIp, int usePort) {
 	return true;
 }
 
+/**
+ * @brief Send and receive through AsyncIO (io_uring, or epoll if the kernel doesn't have it)
+ * 
+ * Call once the socket is connected (and after setNonBlocking()). Queued frames then go out
+ * 		without waiting - the ring sends them while the caller gets on with the next batch.
+ * 
+ * @return int (AsyncIO::ENGINE_X in use)
+ */
+int NetSocket::useAsyncIO() {
+	this->isAsync = true;
+	this->sendIO.init(2 * SEND_BATCH_SIZE);
+	this->recvIO.init(RECV_BATCH_SIZE);
+
+	return this->sendIO.getEngine();
+}
+
+/**
+ * @brief How sends and receives are made (for statistics)
+ */
+string NetSocket::getIOName() {
+	if (!this->isAsync) {
+		return "system calls";
+	}
+
+	return (this->sendIO.getEngine() == AsyncIO::ENGINE_IO_URING) ? "io_uring" : "epoll";
+}
+
+/**
+ * @brief The file descriptor we send and receive on
+ */
+int NetSocket::getSocketToUse() {
+	return (this->getType() == NetSocket::TYPE_CLIENT) ? srv_file_desc : client_socket;
+}
+
+/**
+ * @brief Write a list of buffers to the socket in order, retrying partial writes
+ * 
+ * @return bool (false = the socket failed)
+ */
+bool NetSocket::sendAll(struct iovec *parts, int numParts) {
+	int socketToUse = this->getSocketToUse();
+
+	struct msghdr message = {};
+	message.msg_iov = parts;
+	message.msg_iovlen = numParts;
+
+	while (message.msg_iovlen > 0) {
+		ssize_t sentSize = sendmsg(socketToUse, &message, MSG_NOSIGNAL);
+		this->numSendCalls++;
+
+		if (sentSize < 0) {
+			if (errno == EINTR) continue;
+
+			// Non-blocking and the socket buffer is full - wait for room.
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				struct pollfd pollSocket = {};
+				pollSocket.fd = socketToUse;
+				pollSocket.events = POLLOUT;
+				poll(&pollSocket, 1, -1);
+				continue;
+			}
+			return false;
+		}
+
+		this->bytesSent += sentSize;
+
+		// Skip past whatever made it out
+		while (message.msg_iovlen > 0 && (size_t) sentSize >= message.msg_iov->iov_len) {
+			sentSize -= message.msg_iov->iov_len;
+			message.msg_iov++;
+			message.msg_iovlen--;
+		}
+		if (message.msg_iovlen > 0) {
+			message.msg_iov->iov_base = (char *) message.msg_iov->iov_base + sentSize;
+			message.msg_iov->iov_len -= sentSize;
+		}
+	}
+
+	return true;
+}
+
 /**
  * Send data to server socket
+ * 
+ * The data goes out as one frame: its length, then the data (see getFrame()).
+ * 		With UDP the frame is a single datagram.
  */
-void NetSocket::sendData(string dataToSend) {
-	// What socket are we sending to?
-	int socketToUse = (this->getType() == NetSocket::TYPE_CLIENT) ? srv_file_desc : client_socket;
+void NetSocket::sendData(const string &dataToSend) {
+	if (this->isAsync) {
+		uint32_t netFrameLen = htonl(dataToSend.length());
+
+		struct iovec parts[2];
+		parts[0].iov_base = &netFrameLen;
+		parts[0].iov_len = sizeof(netFrameLen);
+		parts[1].iov_base = (void *) dataToSend.data();
+		parts[1].iov_len = dataToSend.length();
+
+		// Anything queued before goes first
+		this->reapSends(true);
+
+		// UDP - no length, the datagram is the frame
+		bool isUdp = this->transport == NetSocket::TRANSPORT_UDP;
+		if (!this->sendIO.submitSend(this->getSocketToUse(), parts + isUdp, 2 - isUdp, 1)) {
+			cout << "Send Failed...";
+		}
+
+		// The data is the caller's - it has to be sent before we return
+		this->reapSends(true);
+		return;
+	}
+
+	this->numFramesSent++;
+
+	if (this->transport == NetSocket::TRANSPORT_UDP) {
+		this->numSendCalls++;
+		if (send(this->getSocketToUse(), dataToSend.data(), dataToSend.length(), 0) < 0) {
+			cout << "Send Failed...";
+		} else {
+			this->bytesSent += dataToSend.length();
+		}
+		return;
+	}
+
+	uint32_t netFrameLen = htonl(dataToSend.length());
+
+	struct iovec parts[2];
+	parts[0].iov_base = &netFrameLen;
+	parts[0].iov_len = sizeof(netFrameLen);
+	parts[1].iov_base = (void *) dataToSend.data();
+	parts[1].iov_len = dataToSend.length();
 
 	// Send a message
-	if (send(socketToUse, dataToSend.data(), dataToSend.length()+1, 0) < 0) {
+	if (!this->sendAll(parts, 2)) {
 		cout << "Send Failed...";
 	}
 }
 
 /**
- * Get data from the socket
+ * @brief Queue a frame to go out with the next flushQueue()
+ * 
+ * The frame is shared, so the caller is free to change or drop its copy in the meantime.
  */
-string NetSocket::getFromSocket(int packetSize) {
-	// What socket are we getting from?
-	int socketToUse = (this->getType() == NetSocket::TYPE_CLIENT) ? srv_file_desc : client_socket;
+void NetSocket::queueFrame(shared_ptr<const string> frame) {
+	this->sendQueue.push_back(move(frame));
+}
 
-	// How much of a packet do we want to read?
-	// -- We need to account for additional 51 bytes for header information
-	// -- If we don't pass in a packet size, then assume we don't care the size.
-	if (packetSize > 0) packetSize += 51;
-	int buffPacketSize = (packetSize > 0) ? packetSize : 65535;
+/**
+ * @brief Send every queued frame, SEND_BATCH_SIZE frames per system call
+ */
+void NetSocket::flushQueue() {
+	for (size_t first = 0; first < this->sendQueue.size(); first += SEND_BATCH_SIZE) {
+		this->sendBatch(first, min((size_t) SEND_BATCH_SIZE, this->sendQueue.size() - first));
+	}
 
-	// Buffered data we want to return
-	vector <char> fullBufferData;
+	// Hand the sends to the kernel. io_uring finishes them by itself; with epoll nothing would, so wait for them.
+	if (this->isAsync) {
+		this->reapSends(this->sendIO.getEngine() != AsyncIO::ENGINE_IO_URING);
+	}
 
-	int hasRead = 0; // Keep track of how much we read so far
+	this->sendQueue.clear();
+}
 
-	do {
-		// Adjust our buffer and read size based on how much is left
-		// - We need to do this to account for multiple packets being sent at once.
-		int remainToRead = buffPacketSize - hasRead;
-		if (remainToRead == 0) break;
+/**
+ * @brief Collect finished sends (async)
+ * 
+ * Frames (and length prefixes) are released once every send holding them has been reaped.
+ * 
+ * @param wait Wait for every send to finish?
+ */
+void NetSocket::reapSends(bool wait) {
+	AsyncIO::Completion completion;
+
+	while (this->sendIO.getNumInFlight() > 0) {
+		if (!this->sendIO.getCompletion(completion, wait)) {
+			if (wait) {
+				// The engine failed - the kernel may still have the frames, so keep them.
+				cout << "Send Failed...";
+			}
+			break;
+		}
+
+		if (completion.result < 0) {
+			cout << "Send Failed...";
+			continue;
+		}
+
+		this->bytesSent += completion.result;
+		this->numFramesSent += completion.tag;
+	}
+
+	if (this->sendIO.getNumInFlight() == 0) {
+		this->sendingFrames.clear();
+		this->sendingFrameLens.clear();
+	}
+}
+
+/**
+ * @brief Send part of the queue
+ * 
+ * UDP - one sendmmsg() with a datagram per frame.
+ * TCP - one sendmsg() with the length + frame of every frame (more if the socket buffer fills up).
+ * 
+ * Async - the same messages go to the send engine (a send per datagram with UDP). A TCP stream has
+ * 		to go out in order, so a batch waits for the one before it - one send in flight at a time.
+ * 		The frames and their length prefixes are kept until the send is reaped.
+ */
+void NetSocket::sendBatch(size_t first, size_t count) {
+	int socketToUse = this->getSocketToUse();
+	struct iovec parts[2 * SEND_BATCH_SIZE];
+
+	if (this->isAsync) {
+		bool isUdp = this->transport == NetSocket::TRANSPORT_UDP;
+
+		// Wait for the send before this one first - reaping it can release what it was holding
+		if (!isUdp) {
+			this->reapSends(true);
+		}
+		this->sendingFrames.insert(this->sendingFrames.end(), this->sendQueue.begin() + first, this->sendQueue.begin() + first + count);
+
+		for (size_t i = 0; i < count; i++) {
+			const string &frame = *this->sendQueue[first + i];
+			if (!isUdp) {
+				this->sendingFrameLens.push_back(htonl(frame.length()));
+				parts[2 * i].iov_base = &this->sendingFrameLens.back();
+				parts[2 * i].iov_len = sizeof(uint32_t);
+			}
+			parts[2 * i + 1].iov_base = (void *) frame.data();
+			parts[2 * i + 1].iov_len = frame.length();
+
+			if (isUdp && !this->sendIO.submitSend(socketToUse, &parts[2 * i + 1], 1, 1)) {
+				cout << "Send Failed...";
+			}
+		}
 
-		vector <char> recvBuffer(remainToRead);
-		ssize_t dataSize = recv(socketToUse, recvBuffer.data(), recvBuffer.size(), 0);
+		if (!isUdp && !this->sendIO.submitSend(socketToUse, parts, 2 * count, count)) {
+			cout << "Send Failed...";
+		}
+		return;
+	}
+
+	if (this->transport == NetSocket::TRANSPORT_UDP) {
+		struct mmsghdr messages[SEND_BATCH_SIZE] = {};
+
+		for (size_t i = 0; i < count; i++) {
+			const string &frame = *this->sendQueue[first + i];
+			parts[i].iov_base = (void *) frame.data();
+			parts[i].iov_len = frame.length();
+			messages[i].msg_hdr.msg_iov = &parts[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		size_t numSent = 0;
+		while (numSent < count) {
+			int result = sendmmsg(socketToUse, messages + numSent, count - numSent, 0);
+			this->numSendCalls++;
+
+			if (result < 0) {
+				if (errno == EINTR) continue;
+
+				// The first datagram failed - skip it so the rest still go out
+				cout << "Send Failed...";
+				numSent++;
+				continue;
+			}
+
+			for (int i = 0; i < result; i++) {
+				this->bytesSent += messages[numSent + i].msg_len;
+			}
+			numSent += result;
+			this->numFramesSent += result;
+		}
+		return;
+	}
+
+	uint32_t netFrameLens[SEND_BATCH_SIZE];
+	for (size_t i = 0; i < count; i++) {
+		const string &frame = *this->sendQueue[first + i];
+		netFrameLens[i] = htonl(frame.length());
+		parts[2 * i].iov_base = &netFrameLens[i];
+		parts[2 * i].iov_len = sizeof(netFrameLens[i]);
+		parts[2 * i + 1].iov_base = (void *) frame.data();
+		parts[2 * i + 1].iov_len = frame.length();
+	}
+
+	if (!this->sendAll(parts, 2 * count)) {
+		cout << "Send Failed...";
+	} else {
+		this->numFramesSent += count;
+	}
+}
+
+/**
+ * @brief Total number of bytes written to the socket
+ * 
+ * @return long long 
+ */
+long long NetSocket::getBytesSent() {
+	return this->bytesSent;
+}
+
+/**
+ * @brief Get the next frame from the socket
+ * 
+ * Each recv() pulls in as much as the kernel has (up to the free space in the receive buffer),
+ * 		which may be several frames - those are handed out without another system call.
+ * 		Short reads just wait for the rest of the frame.
+ * 
+ * With UDP every datagram is a frame (see getDatagram()).
+ * 
+ * The frame is handed out in place, so it is only valid until the next call.
+ * 
+ * @param frameData Set to the start of the frame
+ * @param frameLen Set to the length of the frame
+ * @return bool (false = the socket was closed or failed - see isClosed() - or, if it is non-blocking, nothing to read yet - see wouldBlock())
+ */
+bool NetSocket::getFrame(const char *&frameData, size_t &frameLen) {
+	this->nothingToRead = false;
+
+	if (this->recvBuffer.empty()) {
+		this->recvBuffer.resize(RECV_BUFFER_SIZE);
+	}
+
+	// UDP - the datagram is the frame.
+	if (this->transport == NetSocket::TRANSPORT_UDP) {
+		return this->getDatagram(frameData, frameLen);
+	}
 
-		// Didn't get any data? Move On
-		if (dataSize == 0) {
+	while (1) {
+		size_t available = this->recvWritePos - this->recvReadPos;
+
+		// Do we have a complete frame already?
+		if (available >= FRAME_HEADER_SIZE) {
+			uint32_t netFrameLen;
+			memcpy(&netFrameLen, &this->recvBuffer[this->recvReadPos], sizeof(netFrameLen));
+			size_t nextFrameLen = ntohl(netFrameLen);
+
+			// A length this large means the stream is out of sync - give up on it.
+			if (nextFrameLen > MAX_FRAME_SIZE) {
+				cout << "Invalid frame length received\n";
+				this->closed = true;
+				return false;
+			}
+
+			if (available >= FRAME_HEADER_SIZE + nextFrameLen) {
+				frameData = &this->recvBuffer[this->recvReadPos + FRAME_HEADER_SIZE];
+				frameLen = nextFrameLen;
+				this->recvReadPos += FRAME_HEADER_SIZE + nextFrameLen;
+				this->numFramesReceived++;
+				return true;
+			}
+
+			// Make sure the whole frame can fit
+			if (FRAME_HEADER_SIZE + nextFrameLen > this->recvBuffer.size()) {
+				this->recvBuffer.resize(FRAME_HEADER_SIZE + nextFrameLen);
+			}
+		}
+
+		// Out of room at the end? Move the partial frame to the front (it's smaller than a frame).
+		if (this->recvWritePos == this->recvBuffer.size() || (available == 0 && this->recvReadPos > 0)) {
+			memmove(&this->recvBuffer[0], &this->recvBuffer[this->recvReadPos], available);
+			this->recvReadPos = 0;
+			this->recvWritePos = available;
+		}
+
+		ssize_t dataSize = this->receive(&this->recvBuffer[this->recvWritePos], this->recvBuffer.size() - this->recvWritePos);
+
+		if (dataSize < 0 && errno == EINTR) {
+			continue;
+		}
+
+		// Non-blocking and nothing has arrived yet
+		if (dataSize < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			this->nothingToRead = true;
+			return false;
+		}
+
+		// Closed or failed?
+		if (dataSize <= 0) {
+			this->closed = true;
+			return false;
+		}
+
+		this->recvWritePos += dataSize;
+	}
+}
+
+/**
+ * @brief Get the next datagram (UDP)
+ * 
+ * One recvmmsg() (or receiveBatch()) waits for the first datagram and grabs whatever else is
+ * 		already waiting; the rest of the batch is handed out without another system call.
+ * 
+ * @return bool (false = the socket failed)
+ */
+bool NetSocket::getDatagram(const char *&frameData, size_t &frameLen) {
+	int socketToUse = this->getSocketToUse();
+
+	while (1) {
+		if (this->recvBatchPos >= this->recvBatchCount) {
+
+			// Slots for as many datagrams as the buffer holds
+			int numSlots = max(1, min((int) RECV_BATCH_SIZE, (int) (this->recvBuffer.size() / this->maxFrameSize)));
+			this->recvMessages.assign(numSlots, mmsghdr());
+			this->recvSlots.resize(numSlots);
+			for (int i = 0; i < numSlots; i++) {
+				this->recvSlots[i].iov_base = &this->recvBuffer[i * this->maxFrameSize];
+				this->recvSlots[i].iov_len = this->maxFrameSize;
+				this->recvMessages[i].msg_hdr.msg_iov = &this->recvSlots[i];
+				this->recvMessages[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			int result;
+			if (this->isAsync) {
+				result = this->receiveBatch(numSlots);
+			} else {
+				result = recvmmsg(socketToUse, this->recvMessages.data(), numSlots, MSG_WAITFORONE, nullptr);
+				this->numRecvCalls++;
+			}
+
+			if (result < 0) {
+				if (errno == EINTR) continue;
+
+				// Non-blocking and nothing has arrived yet
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					this->nothingToRead = true;
+					return false;
+				}
+
+				// Nothing to close with UDP - this is an error such as the peer's port being unreachable.
+				return false;
+			}
+
+			this->recvBatchCount = result;
+			this->recvBatchPos = 0;
+		}
+
+		struct mmsghdr &message = this->recvMessages[this->recvBatchPos];
+		this->recvBatchPos++;
+
+		// Too big for the slot - treat it as lost rather than hand out part of it.
+		if (message.msg_hdr.msg_flags & MSG_TRUNC) {
+			continue;
+		}
+
+		frameData = (const char *) message.msg_hdr.msg_iov->iov_base;
+		frameLen = message.msg_len;
+		this->numFramesReceived++;
+		return true;
+	}
+
+}
+
+/**
+ * @brief Receive into a buffer - recv(), or through the receive engine (async)
+ * 
+ * A non-blocking socket asks the engine not to wait (MSG_DONTWAIT), so nothing is left pending
+ * 		to take data the caller's epoll would have told it about.
+ * 
+ * @return ssize_t (like recv() - bytes, 0 = closed, -1 with errno set)
+ */
+ssize_t NetSocket::receive(char *buffer, size_t len) {
+	if (!this->isAsync) {
+		this->numRecvCalls++;
+		return recv(this->getSocketToUse(), buffer, len, 0);
+	}
+
+	AsyncIO::Completion completion;
+	if (!this->recvIO.submitRecv(this->getSocketToUse(), buffer, len, (this->nonBlocking) ? MSG_DONTWAIT : 0, 0)
+			|| !this->recvIO.getCompletion(completion, true)) {
+		errno = EIO;
+		return -1;
+	}
+
+	if (completion.result < 0) {
+		errno = -completion.result;
+		return -1;
+	}
+	return completion.result;
+}
+
+/**
+ * @brief Fill recvMessages through the receive engine (async UDP) - like recvmmsg() with MSG_WAITFORONE
+ * 
+ * A receive per slot, none of them waiting, all handed to io_uring at once. If nothing had arrived
+ * 		(and the socket blocks) one receive waits for the next datagram.
+ * 
+ * @return int (datagrams received, or -1 with errno set)
+ */
+int NetSocket::receiveBatch(int numSlots) {
+	int socketToUse = this->getSocketToUse();
+	bool isRing = this->recvIO.getEngine() == AsyncIO::ENGINE_IO_URING;
+	AsyncIO::Completion completion;
+
+	this->recvResults.assign(numSlots, -EAGAIN);
+	for (int i = 0; i < numSlots; i++) {
+		if (!this->recvIO.submitRecv(socketToUse, (char *) this->recvSlots[i].iov_base, this->maxFrameSize, MSG_DONTWAIT | MSG_TRUNC, i)) {
 			break;
 		}
 
-		// How much have we read?
-		hasRead += dataSize;
+		// epoll - the receive has already run, so stop once the socket is empty
+		if (!isRing && this->recvIO.getCompletion(completion, false)) {
+			this->recvResults[completion.tag] = completion.result;
+			if (completion.result < 0) break;
+		}
+	}
 
-		// Resize the buffer
-		recvBuffer.resize(dataSize);
+	if (isRing) {
+		while (this->recvIO.getNumInFlight() > 0 && this->recvIO.getCompletion(completion, true)) {
+			this->recvResults[completion.tag] = completion.result;
+		}
+	}
 
-		// Add the data to our master vector.
-		fullBufferData.insert(fullBufferData.end(), recvBuffer.begin(), recvBuffer.end());
+	// Nothing yet - wait for one
+	if (count(this->recvResults.begin(), this->recvResults.end(), -EAGAIN) == numSlots && !this->nonBlocking) {
+		if (!this->recvIO.submitRecv(socketToUse, (char *) this->recvSlots[0].iov_base, this->maxFrameSize, MSG_TRUNC, 0)
+				|| !this->recvIO.getCompletion(completion, true)) {
+			errno = EIO;
+			return -1;
+		}
+		this->recvResults[0] = completion.result;
+	}
 
-	} while (packetSize != 0 && hasRead < packetSize);
+	// Line up the datagrams at the front, like recvmmsg() would have
+	int numReceived = 0;
+	int error = EAGAIN;
+	for (int i = 0; i < numSlots; i++) {
+		long long result = this->recvResults[i];
+		if (result < 0) {
+			if (result != -EAGAIN) error = -result;
+			continue;
+		}
+
+		struct msghdr &header = this->recvMessages[numReceived].msg_hdr;
+		header.msg_iov = &this->recvSlots[i];
+		header.msg_iovlen = 1;
+		header.msg_flags = ((size_t) result > this->maxFrameSize) ? MSG_TRUNC : 0;
+		this->recvMessages[numReceived].msg_len = min((size_t) result, this->maxFrameSize);
+		numReceived++;
+	}
 
-	// Nothing in our buffer? Nothing to return
-	if (fullBufferData.size() == 0) {
+	if (numReceived == 0) {
+		errno = error;
+		return -1;
+	}
+	return numReceived;
+}
+
+/**
+ * Get data from the socket
+ * 
+ * Returns a copy of the next frame, or "" if the socket was closed.
+ */
+string NetSocket::getFromSocket() {
+	const char *frameData;
+	size_t frameLen;
+
+	if (!this->getFrame(frameData, frameLen)) {
 		return "";
 	}
 
-	return string(fullBufferData.begin(), fullBufferData.end()-1);
+	return string(frameData, frameLen);
+}
+
+/**
+ * @brief Is there a frame getFrame() can hand out without a system call?
+ * 
+ * @return bool 
+ */
+bool NetSocket::hasBufferedFrame() {
+	if (this->transport == NetSocket::TRANSPORT_UDP) {
+		return this->recvBatchPos < this->recvBatchCount;
+	}
+
+	size_t available = this->recvWritePos - this->recvReadPos;
+	if (available < FRAME_HEADER_SIZE) {
+		return false;
+	}
+
+	uint32_t netFrameLen;
+	memcpy(&netFrameLen, &this->recvBuffer[this->recvReadPos], sizeof(netFrameLen));
+	return available >= FRAME_HEADER_SIZE + ntohl(netFrameLen);
+}
+
+/**
+ * @brief Wait for something to read
+ * 
+ * Frames already in the receive buffer count, as does the socket closing (getFrame() will report it).
+ * 
+ * @param timeoutMS Max time to wait (-1 = forever)
+ * @return bool (false = timed out)
+ */
+bool NetSocket::waitForData(int timeoutMS) {
+
+	// A complete frame waiting in the buffer?
+	if (this->hasBufferedFrame()) {
+		return true;
+	}
+
+	struct pollfd pollSocket = {};
+	pollSocket.fd = this->getSocketToUse();
+	pollSocket.events = POLLIN;
+
+	int result;
+	do {
+		result = poll(&pollSocket, 1, timeoutMS);
+	} while (result < 0 && errno == EINTR);
+
+	return result > 0;
+}
+
+/**
+ * @brief Largest frame we expect (UDP)
+ * 
+ * Sizes the datagram slots - the smaller they are, the more datagrams fit in one recvmmsg().
+ * 		Takes effect with the next batch.
+ */
+void NetSocket::setMaxFrameSize(size_t maxFrameSize) {
+	this->maxFrameSize = max((size_t) 1, min(maxFrameSize, (size_t) MAX_DATAGRAM_SIZE));
+}
+
+/**
+ * @brief Has the peer closed the connection?
+ * 
+ * @return bool 
+ */
+bool NetSocket::isClosed() {
+	return this->closed;
+}
+
+/**
+ * @brief Did the last getFrame() come back empty only because nothing had arrived yet? (non-blocking)
+ * 
+ * @return bool 
+ */
+bool NetSocket::wouldBlock() {
+	return this->nothingToRead;
+}
+
+/**
+ * @brief Number of recv() system calls made (async: the receive engine's)
+ */
+long long NetSocket::getNumRecvCalls() {
+	return (this->isAsync) ? this->recvIO.getNumSystemCalls() : this->numRecvCalls;
+}
+
+/**
+ * @brief Number of frames received
+ */
+long long NetSocket::getNumFramesReceived() {
+	return this->numFramesReceived;
+}
+
+/**
+ * @brief Number of send system calls made (async: the send engine's)
+ */
+long long NetSocket::getNumSendCalls() {
+	return (this->isAsync) ? this->sendIO.getNumSystemCalls() : this->numSendCalls;
+}
+
+/**
+ * @brief Number of frames sent
+ */
+long long NetSocket::getNumFramesSent() {
+	return this->numFramesSent;
+}
+
+/**
+ * @brief Stop receiving (sending still works)
+ * 
+ * Wakes up anything waiting on the socket - with UDP there's no close from the peer to do it.
+ */
+void NetSocket::stopReceiving() {
+	shutdown(this->getSocketToUse(), SHUT_RD);
 }
 
 /**
  * @brief Close the socket
  */
 void NetSocket::closeSocket() {
-	close(srv_file_desc);
+	if (this->isAsync) {
+		this->reapSends(true);
+	}
+
+	// Accepted connections only have the connection itself (see acceptConnection())
+	if (this->getType() == NetSocket::TYPE_SERVER && client_socket >= 0 && client_socket != srv_file_desc) {
+		close(client_socket);
+	}
+	if (srv_file_desc >= 0) {
+		close(srv_file_desc);
+	}
 }
\ No newline at end of file
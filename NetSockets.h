@@ -1,5 +1,10 @@
+#include <sys/socket.h>
 #include <netinet/in.h>
 #include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include "AsyncIO.h"
 using namespace std;
 #ifndef NETSOCKET_H
 #define NETSOCKET_H
@@ -9,17 +14,98 @@ class NetSocket {
 	private:
 		struct sockaddr_in address;
 		int socketType;
-		int srv_file_desc, client_socket;
+		int srv_file_desc = -1, client_socket = -1;
+		int transport = 1;			// TRANSPORT_X (set before creating the socket)
+		bool closed = false;		// Has the peer closed the connection? (TCP only)
+		bool nothingToRead = false;	// Did the last getFrame() stop because nothing had arrived yet? (non-blocking)
+		bool nonBlocking = false;	// Set by setNonBlocking()
+		long long bytesSent = 0;	// Bytes written to the socket (headers + data)
+
+		// Receive buffer - reused for the life of the socket. Frames are handed out in place.
+		vector<char> recvBuffer;
+		size_t recvReadPos = 0;		// Start of the first frame we haven't handed out
+		size_t recvWritePos = 0;	// End of the data received so far
+		long long numRecvCalls = 0;	// recv() system calls
+		long long numFramesReceived = 0;
+
+		// UDP receive batch - one slot of maxFrameSize bytes per datagram, carved from recvBuffer
+		vector<struct mmsghdr> recvMessages;
+		vector<struct iovec> recvSlots;
+		size_t maxFrameSize = MAX_DATAGRAM_SIZE;
+		int recvBatchCount = 0;		// Datagrams in the current batch
+		int recvBatchPos = 0;		// Next datagram to hand out
+
+		// Frames waiting for flushQueue()
+		vector<shared_ptr<const string>> sendQueue;
+		long long numSendCalls = 0;	// send system calls
+		long long numFramesSent = 0;
+
+		// Async I/O (see useAsyncIO()) - sends are one engine, receives another, so each can have its own thread
+		bool isAsync = false;
+		AsyncIO sendIO;
+		AsyncIO recvIO;
+		vector<shared_ptr<const string>> sendingFrames;	// Frames the engine is still sending
+		deque<uint32_t> sendingFrameLens;				// Their length prefixes (TCP) - a deque, so they stay put
+		vector<long long> recvResults;					// UDP receive batch - result per slot
+
+		int getSocketToUse();
+		bool sendAll(struct iovec *parts, int numParts);
+		void sendBatch(size_t first, size_t count);
+		bool getDatagram(const char *&frameData, size_t &frameLen);
+		void reapSends(bool wait);
+		ssize_t receive(char *buffer, size_t len);
+		int receiveBatch(int numSlots);
 
 	public:
 		static const int TYPE_SERVER = 1;
 		static const int TYPE_CLIENT = 2;
+
+		// Transports
+		// - TRANSPORT_TCP: a byte stream - frames are length prefixed (see getFrame())
+		// - TRANSPORT_UDP: one frame per datagram - loss, reordering and duplicates are left to the protocol
+		static const int TRANSPORT_TCP = 1;
+		static const int TRANSPORT_UDP = 2;
+		static const size_t MAX_DATAGRAM_SIZE = 65507;
+
+		// Frames are sent as a 4-byte length (network order) followed by the frame itself
+		static const size_t FRAME_HEADER_SIZE = 4;
+		static const size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+		static const size_t RECV_BUFFER_SIZE = 256 * 1024;
+
+		// Max frames per batched system call (sendmmsg / recvmmsg, or one sendmsg for TCP)
+		static const int SEND_BATCH_SIZE = 64;
+		static const int RECV_BATCH_SIZE = 64;
+
 		bool createServerSocket(int usePort);
+		bool createListenSocket(int usePort, int backlog);
+		bool acceptConnection(NetSocket &connection);
+		bool setNonBlocking();
+		bool isNonBlocking();
+		int getFileDescriptor();
 		bool createClientSocket(string serverIp, int usePort);
+		int useAsyncIO();
+		string getIOName();
 		void setType(int socketType);
 		int getType();
-		void sendData(string dataToSend);
-		string getFromSocket(int packetSize);
+		void setTransport(int transport);
+		int getTransport();
+		static string getTransportName(int transport);
+		void sendData(const string &dataToSend);
+		void queueFrame(shared_ptr<const string> frame);
+		void flushQueue();
+		bool getFrame(const char *&frameData, size_t &frameLen);
+		string getFromSocket();
+		bool hasBufferedFrame();
+		bool waitForData(int timeoutMS);
+		void setMaxFrameSize(size_t maxFrameSize);
+		bool isClosed();
+		bool wouldBlock();
+		long long getBytesSent();
+		long long getNumRecvCalls();
+		long long getNumFramesReceived();
+		long long getNumSendCalls();
+		long long getNumFramesSent();
+		void stopReceiving();
 		void closeSocket();
 };
 
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <algorithm>
+#include "Pacer.h"
+using namespace std;
+
+/**
+ * @brief No rate yet - nothing is paced
+ */
+Pacer::Pacer() {
+}
+
+/**
+ * @brief Bytes the bucket holds
+ */
+double Pacer::getBurstBytes() {
+	return max(MIN_BURST_PACKETS * this->packetBytes, this->bytesPerUS * MAX_BURST_US);
+}
+
+/**
+ * @brief Add the bytes earned since the last refill (up to a full bucket)
+ */
+void Pacer::refill(chrono::steady_clock::time_point now) {
+	if (now <= this->refillTimePoint) {
+		return;
+	}
+
+	double elapsedUS = chrono::duration<double, micro>(now - this->refillTimePoint).count();
+	this->tokens = min(this->getBurstBytes(), this->tokens + elapsedUS * this->bytesPerUS);
+	this->refillTimePoint = now;
+}
+
+/**
+ * @brief Target rate in bytes per second (0 = no pacing) and the size of a full packet
+ *
+ * Whatever was earned at the old rate is kept. Turning pacing on starts with a full bucket.
+ */
+void Pacer::setRate(double bytesPerSecond, int packetBytes) {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	bool wasEnabled = this->isEnabled();
+
+	if (wasEnabled) {
+		this->refill(now);
+	}
+	this->bytesPerUS = max(0.0, bytesPerSecond / 1000000);
+	this->packetBytes = max(1, packetBytes);
+
+	if (!wasEnabled && this->isEnabled()) {
+		this->tokens = this->getBurstBytes();
+		this->refillTimePoint = now;
+	}
+}
+
+/**
+ * @brief Is there a rate to keep to?
+ */
+bool Pacer::isEnabled() {
+	return this->bytesPerUS > 0;
+}
+
+/**
+ * @brief Can a packet go now? (always, without pacing)
+ */
+bool Pacer::canSend(chrono::steady_clock::time_point now) {
+	if (!this->isEnabled()) {
+		return true;
+	}
+
+	this->refill(now);
+	return this->tokens > 0;
+}
+
+/**
+ * @brief When the next packet can go (now, if it already can)
+ */
+chrono::steady_clock::time_point Pacer::getSendTime(chrono::steady_clock::time_point now) {
+	if (this->canSend(now)) {
+		return now;
+	}
+
+	// Just past the point where the bucket is no longer empty
+	double waitUS = -this->tokens / this->bytesPerUS + 1;
+	return now + chrono::microseconds((long long) waitUS);
+}
+
+/**
+ * @brief A packet went out - take its bytes from the bucket
+ */
+void Pacer::onSend(chrono::steady_clock::time_point now, int bytes) {
+	if (!this->isEnabled()) {
+		return;
+	}
+
+	this->refill(now);
+	this->tokens -= bytes;
+	this->bytesPaced += bytes;
+	this->rateTotal += this->bytesPerUS;
+	this->numPackets++;
+}
+
+/**
+ * @brief A packet has to wait for the bucket
+ */
+void Pacer::onWait(chrono::steady_clock::time_point now) {
+	this->numWaits++;
+	this->waitTotalUS += chrono::duration<double, micro>(this->getSendTime(now) - now).count();
+}
+
+/**
+ * @brief Current target rate (Mbps, 0 = no pacing)
+ */
+double Pacer::getRateMbps() {
+	return this->bytesPerUS * 8;
+}
+
+/**
+ * @brief Average target rate over every packet sent (Mbps)
+ */
+double Pacer::getAverageRateMbps() {
+	return (this->numPackets > 0) ? this->rateTotal / this->numPackets * 8 : this->getRateMbps();
+}
+
+/**
+ * @brief Number of times a packet had to wait
+ */
+long long Pacer::getNumWaits() {
+	return this->numWaits;
+}
+
+/**
+ * @brief Average wait for the bucket (us)
+ */
+double Pacer::getAverageWaitUS() {
+	return (this->numWaits > 0) ? this->waitTotalUS / this->numWaits : 0;
+}
@@ -0,0 +1,63 @@
+#include <chrono>
+using namespace std;
+#ifndef PACER_H
+#define PACER_H
+
+/**
+ * Pacer
+ *
+ * Spreads packets out at a target rate (a token bucket) instead of letting a whole window leave
+ * 		at once. The bucket fills at the rate and holds MAX_BURST_US worth of bytes (at least
+ * 		MIN_BURST_PACKETS), so packets still go out in small batches - one system call each -
+ * 		just not faster than the rate on average.
+ *
+ * A packet can go as long as the bucket isn't empty - it may take the bucket below zero, and the
+ * 		next one waits until it fills back up.
+ *
+ * Not thread-safe - use from one thread (or under the caller's lock).
+ */
+class Pacer {
+
+	public:
+		static const int MAX_BURST_US = 1000;		// The bucket holds this long at the rate
+		static const int MIN_BURST_PACKETS = 2;
+
+	private:
+		double bytesPerUS = 0;			// Target rate (0 = no pacing)
+		double packetBytes = 1;			// Size of a full packet (for the burst)
+		double tokens = 0;				// Bytes we can send right now (can go below 0)
+		chrono::steady_clock::time_point refillTimePoint;	// Last time the bucket was filled
+
+		// Statistics
+		long long bytesPaced = 0;
+		long long numWaits = 0;
+		double waitTotalUS = 0;
+		double rateTotal = 0;			// Rate at every packet (for the average)
+		long long numPackets = 0;
+
+		double getBurstBytes();
+		void refill(chrono::steady_clock::time_point now);
+
+	public:
+		Pacer();
+
+		// Target rate in bytes per second (0 = no pacing) and the size of a full packet
+		void setRate(double bytesPerSecond, int packetBytes);
+		bool isEnabled();
+
+		// Can a packet go now? If not, when?
+		bool canSend(chrono::steady_clock::time_point now);
+		chrono::steady_clock::time_point getSendTime(chrono::steady_clock::time_point now);
+
+		// A packet went out / we had to wait for the bucket
+		void onSend(chrono::steady_clock::time_point now, int bytes);
+		void onWait(chrono::steady_clock::time_point now);
+
+		// Statistics
+		double getRateMbps();
+		double getAverageRateMbps();
+		long long getNumWaits();
+		double getAverageWaitUS();
+};
+
+#endif
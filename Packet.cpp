@@ -4,9 +4,31 @@
 #include <sstream>
 #include <vector>
 #include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
 #include "Packet.h"
+#include "Checksum.h"
 using namespace std;
 
+// Time and bytes spent computing integrity values (for statistics)
+static atomic<long long> integrityTimeNS(0);
+static atomic<long long> integrityBytes(0);
+
+// Bytes of packet string we did not have to rebuild thanks to the frame cache (for statistics)
+static atomic<long long> frameBytesSaved(0);
+
+// Bytes of packet data copied from one buffer to another (for statistics)
+static atomic<long long> bytesCopied(0);
+static thread_local long long threadBytesCopied = 0;	// The same, by this thread only (sessions count their own share)
+
+/**
+ * @brief Count packet data copied between buffers (process-wide and for this thread)
+ */
+static void countCopy(size_t numBytes) {
+	bytesCopied += numBytes;
+	threadBytesCopied += numBytes;
+}
+
 /**
  * Empty Constructor
  */
@@ -18,6 +40,7 @@ Packet::Packet() {
  */
 void Packet::setSeqNum(int seqNum) {
 	this->seqNum = seqNum;
+	clearFrame();
 }
 
 /**
@@ -59,18 +82,249 @@ int Packet::getSeqNumRange(){
 }
 
 
+/**
+ * Set the wire header format used when creating the packet string
+ */
+void Packet::setHeaderVersion(int headerVersion) {
+	this->headerVersion = headerVersion;
+	clearFrame();
+}
+
+/**
+ * Return the wire header format
+ */
+int Packet::getHeaderVersion() {
+	return this->headerVersion;
+}
+
+/**
+ * Return the number of header bytes that precede the data for a header format
+ * 
+ * The binary header's integrity field is sized for the algorithm in use.
+ */
+int Packet::getHeaderSize(int headerVersion, int integrity) {
+	if (headerVersion != HEADER_BINARY) {
+		return HEADER_ASCII_SIZE;
+	}
+
+	if (integrity == INTEGRITY_CRC32C) {
+		return HEADER_BINARY_SIZE + 2;
+	} else if (integrity == INTEGRITY_NONE) {
+		return HEADER_BINARY_SIZE - 2;
+	}
+
+	return HEADER_BINARY_SIZE;
+}
+
+/**
+ * Set the integrity algorithm used when creating the packet string
+ */
+void Packet::setIntegrity(int integrity) {
+	this->integrity = integrity;
+	clearFrame();
+}
+
+/**
+ * Return the integrity algorithm
+ */
+int Packet::getIntegrity() {
+	return this->integrity;
+}
+
+/**
+ * Readable integrity algorithm name
+ */
+string Packet::getIntegrityName(int integrity) {
+	switch (integrity) {
+		case INTEGRITY_CRC32C:
+			return "CRC32C";
+		case INTEGRITY_NONE:
+			return "None";
+		default:
+			return "Checksum";
+	}
+}
+
+/**
+ * Total time spent computing integrity values in this process (nanoseconds)
+ */
+long long Packet::getIntegrityTimeNS() {
+	return integrityTimeNS;
+}
+
+/**
+ * Total bytes run through integrity computations in this process
+ */
+long long Packet::getIntegrityBytes() {
+	return integrityBytes;
+}
+
 /**
  * Set Packet Data
  */
 void Packet::setData(vector <char> data) {
-	this->data = data;
+	if (!data.empty()) {
+		memcpy(prepareData(data.size()), data.data(), data.size());
+		countCopy(data.size());
+	} else {
+		prepareData(0);
+	}
 }
 
 /**
  * Return data in the packet
+ * 
+ * This is a copy - use getDataView() to read the data in place.
  */
 vector <char> Packet::getData() {
-	return this->data;
+	const char *dataPtr = getDataPtr();
+	countCopy(getDataSize());
+	return vector<char>(dataPtr, dataPtr + getDataSize());
+}
+
+/**
+ * Return a pointer to the data in the packet
+ */
+const char *Packet::getDataPtr() {
+	switch (this->dataSource) {
+		case DATA_SLAB:
+			return this->slab;
+		case DATA_VIEW:
+			return this->borrowedData.data;
+		default:
+			return this->data.data();
+	}
+}
+
+/**
+ * Return the number of bytes of data in the packet
+ */
+size_t Packet::getDataSize() {
+	switch (this->dataSource) {
+		case DATA_SLAB:
+			return this->slabDataSize;
+		case DATA_VIEW:
+			return this->borrowedData.size;
+		default:
+			return this->data.size();
+	}
+}
+
+/**
+ * @brief Borrow the data from another buffer instead of copying it
+ * 
+ * The packet only points at the buffer, so the buffer must outlive any use of the data.
+ * 		Call ownData() before keeping the packet around longer than that.
+ */
+void Packet::setDataView(DataView dataView) {
+	clearFrame();
+	this->borrowedData = dataView;
+	this->dataSource = DATA_VIEW;
+}
+
+/**
+ * @brief View of the data wherever it lives (no copy)
+ */
+DataView Packet::getDataView() {
+	DataView dataView = { getDataPtr(), getDataSize() };
+	return dataView;
+}
+
+/**
+ * @brief Is the data borrowed from another buffer?
+ */
+bool Packet::isDataBorrowed() {
+	return this->dataSource == DATA_VIEW;
+}
+
+/**
+ * @brief Take ownership of borrowed data by copying it into the packet (slab or vector)
+ */
+void Packet::ownData() {
+	if (this->dataSource != DATA_VIEW) {
+		return;
+	}
+
+	DataView dataView = this->borrowedData;
+	char *dest = prepareData(dataView.size);
+	if (dataView.size > 0) {
+		memcpy(dest, dataView.data, dataView.size);
+		countCopy(dataView.size);
+	}
+}
+
+/**
+ * @brief Total bytes of packet data copied between buffers in this process
+ * 
+ * Includes building packet strings, taking ownership of borrowed data, and getData() copies.
+ */
+long long Packet::getBytesCopied() {
+	return bytesCopied;
+}
+
+/**
+ * @brief Bytes of packet data copied between buffers by the calling thread
+ *
+ * Take the difference around a piece of work to count just its copies (other threads don't add to it).
+ */
+long long Packet::getThreadBytesCopied() {
+	return threadBytesCopied;
+}
+
+/**
+ * @brief Size the packet data and return where to write it
+ * 
+ * Uses the slab when one is attached and the data fits, so pooled packets never allocate.
+ * 
+ * @param dataSize Number of bytes of data
+ * @return char* 
+ */
+char *Packet::prepareData(size_t dataSize) {
+	clearFrame();
+
+	if (this->slab != nullptr && dataSize <= this->slabCapacity) {
+		this->dataSource = DATA_SLAB;
+		this->slabDataSize = dataSize;
+		return this->slab;
+	}
+
+	this->dataSource = DATA_VECTOR;
+	this->data.resize(dataSize);
+	return this->data.data();
+}
+
+/**
+ * @brief Attach a (pool-owned) buffer to hold the packet data
+ */
+void Packet::attachSlab(char *slab, size_t slabCapacity) {
+	this->slab = slab;
+	this->slabCapacity = slabCapacity;
+	this->slabDataSize = 0;
+	this->dataSource = DATA_VECTOR;
+	clearFrame();
+}
+
+/**
+ * @brief Return the packet to a blank state
+ * 
+ * The slab and the frame storage stay attached so the next use of the packet doesn't allocate.
+ */
+void Packet::reset() {
+	this->seqNum = 0;
+	this->seqNumRange = 0;
+	this->ack = 0;
+	this->checksum = 0;
+	this->headerVersion = HEADER_ASCII;
+	this->integrity = INTEGRITY_CHECKSUM;
+	this->data.clear();
+	this->slabDataSize = 0;
+	this->borrowedData.data = nullptr;
+	this->borrowedData.size = 0;
+	this->dataSource = DATA_VECTOR;
+	this->numSends = 0;
+	this->resendCounted = false;
+	this->timerId = -1;
+	clearFrame();
 }
 
 /**
@@ -78,6 +332,7 @@ vector <char> Packet::getData() {
  */
 void Packet::setAck(int ack) {
 	this->ack = ack;
+	clearFrame();
 }
 
 /**
@@ -90,45 +345,52 @@ int Packet::getAck() {
 /**
  * Set the stored checksum
  */
-void Packet::setChecksum(int checksum) {
+void Packet::setChecksum(unsigned int checksum) {
 	this->checksum = checksum;
 }
 
 /**
  * Return the stored checksum
  */
-int Packet::getChecksum() {
+unsigned int Packet::getChecksum() {
 	return this->checksum;
 }
 
 /**
  * Create a checksum based on the data
+ * 
+ * The binary header uses the RFC 1071 16-bit word checksum. The ASCII header keeps the original
+ * 		per-byte sum so older peers still validate our packets.
  */
 u_short Packet::createChecksum() {
+	if (this->headerVersion == HEADER_BINARY) {
+		return Checksum::internet(getDataPtr(), getDataSize());
+	}
 
-	// Convert data to binary (needed for checksum)
-	int dataLen = this->data.size();
-	vector <unsigned short> dataCSArray;
-	int dataCSArrayLen = 0;
+	return Checksum::legacy(getDataPtr(), getDataSize());
+}
 
-	// Break the data into 16-bit blocks
-	for (int i = 0; i < dataLen; i++) {
-		dataCSArray.push_back((unsigned short) bitset<16>(this->data[i]).to_ulong());
-		dataCSArrayLen++;
+/**
+ * Create the integrity value for the data based on the packet's algorithm
+ * 
+ * The ASCII header only has room for the 16-bit checksum, so it always uses that.
+ */
+unsigned int Packet::createIntegrityValue() {
+	chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+	unsigned int value = 0;
+
+	if (this->headerVersion == HEADER_BINARY && this->integrity == INTEGRITY_NONE) {
+		return 0;
+	} else if (this->headerVersion == HEADER_BINARY && this->integrity == INTEGRITY_CRC32C) {
+		value = Checksum::crc32c(getDataPtr(), getDataSize());
+	} else {
+		value = createChecksum();
 	}
 
-	unsigned short* buffer = &dataCSArray[0];
+	integrityTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startTime).count();
+	integrityBytes += getDataSize();
 
-	// Calculate the checksum
-	u_long sum = 0;
-	while (dataCSArrayLen--) {
-		sum += *buffer++;
-		if (sum & 0xFFFF0000) {
-			sum &= 0xFFFF;
-			sum++;
-		}
-	}
-	return ~(sum & 0xFFFF);
+	return value;
 }
 
 /*
@@ -139,54 +401,207 @@ string Packet::createPacketString() {
 }
 string Packet::createPacketString(bool forceNACK = false) {
 	string pktString = "";
+	writePacketString(pktString, forceNACK);
+	return pktString;
+}
 
-	// Add the sequence number to the packet string
-	string seqNumStr = bitset<32>(this->getSeqNum()).to_string();
-	pktString += seqNumStr;
+/**
+ * @brief Write the packet string into an existing string
+ * 
+ * Reuses the string's capacity, which lets the frame cache avoid allocating.
+ */
+void Packet::writePacketString(string &pktString, bool forceNACK) {
+	const char *dataPtr = getDataPtr();
+	size_t dataLen = getDataSize();
 
-	// Add an ack to the packet string
-	pktString += bitset<2>(getAck()).to_string();
+	pktString.clear();
 
-	// Determine a checksum, add it to the packet string
-	u_short checksum = createChecksum();
+	// Determine a checksum
+	unsigned int checksum = createIntegrityValue();
 
-	// Forcing a NACK / failed checksum?
+	// Forcing a NACK / failed checksum? (No effect without an integrity check)
 	if (forceNACK) {
 		checksum = 0;
 	}
 
+	// Binary header: version, ack + integrity, checksum and sequence number packed in network byte order
+	if (this->headerVersion == HEADER_BINARY) {
+		uint32_t netSeqNum = htonl(this->getSeqNum());
+
+		pktString.reserve(getHeaderSize(HEADER_BINARY, this->integrity) + dataLen);
+		pktString += (char) HEADER_BINARY;
+		pktString += (char) ((getAck() & 0x03) | ((this->integrity & 0x03) << 2));
+
+		if (this->integrity == INTEGRITY_CRC32C) {
+			uint32_t netChecksum = htonl(checksum);
+			pktString.append((const char *) &netChecksum, sizeof(netChecksum));
+		} else if (this->integrity != INTEGRITY_NONE) {
+			uint16_t netChecksum = htons((u_short) checksum);
+			pktString.append((const char *) &netChecksum, sizeof(netChecksum));
+		}
+
+		pktString.append((const char *) &netSeqNum, sizeof(netSeqNum));
+		pktString.append(dataPtr, dataLen);
+		countCopy(dataLen);
+
+		return;
+	}
+
+	// Add the sequence number to the packet string
+	string seqNumStr = bitset<32>(this->getSeqNum()).to_string();
+	pktString += seqNumStr;
+
+	// Add an ack to the packet string
+	pktString += bitset<2>(getAck()).to_string();
+
+	// Add the checksum to the packet string
 	pktString += bitset<16>(checksum).to_string();
 
 	// Add the actual data to the packet string
-	int dataLen = this->data.size();
-	string dataBin = "";
-	for (int i = 0; i < dataLen; i++) {	
-		pktString += this->data[i];
+	pktString.append(dataPtr, dataLen);
+	countCopy(dataLen);
+}
+
+/**
+ * @brief Get the packet string, building it only the first time
+ * 
+ * Retransmissions send the exact same bytes, so we keep the packet string around instead of
+ * 		recomputing the checksum and copying the data again. A forced NACK is a different
+ * 		packet string, so it is cached separately.
+ * 
+ * @param forceNACK Send a failed checksum
+ * @return shared_ptr<const string> 
+ */
+shared_ptr<const string> Packet::getFrame(bool forceNACK) {
+	shared_ptr<string> &cachedFrame = (forceNACK) ? this->nackFrame : this->frame;
+	bool &hasCachedFrame = (forceNACK) ? this->hasNackFrame : this->hasFrame;
+
+	if (hasCachedFrame) {
+		frameBytesSaved += cachedFrame->size();
+		return cachedFrame;
 	}
 
-	return pktString;
+	// Reuse the old storage unless someone is still holding on to it
+	if (!cachedFrame || cachedFrame.use_count() > 1) {
+		cachedFrame = make_shared<string>();
+	}
+
+	writePacketString(*cachedFrame, forceNACK);
+	hasCachedFrame = true;
+
+	return cachedFrame;
+}
+
+/**
+ * @brief Mark the cached packet strings as out of date (the packet changed)
+ */
+void Packet::clearFrame() {
+	this->hasFrame = false;
+	this->hasNackFrame = false;
+}
+
+/**
+ * @brief Total bytes of packet strings reused instead of rebuilt in this process
+ */
+long long Packet::getFrameBytesSaved() {
+	return frameBytesSaved;
 }
 
 /*
 Take a binary input of packet data and determine its details
 */
 void Packet::reversePacket(string inputData) {
+	reversePacketView(inputData.data(), inputData.length());
+
+	// inputData goes away when we return, so keep our own copy of the data.
+	ownData();
+}
+
+/**
+ * @brief Is the ASCII header all '0' / '1' characters? (bitset would throw on anything else)
+ * 
+ * @param inputData At least HEADER_ASCII_SIZE bytes
+ */
+static bool isAsciiHeader(const char *inputData) {
+	for (int i = 0; i < Packet::HEADER_ASCII_SIZE; i++) {
+		if (inputData[i] != '0' && inputData[i] != '1') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Determine the packet details from a buffer without copying the data
+ * 
+ * The packet's data is borrowed from inputData (see setDataView), so the buffer must stay
+ * 		untouched while the data is in use - or call ownData() to keep it.
+ * 
+ * @param inputData Packet string (header + data)
+ * @param inputLen Length of the packet string
+ */
+void Packet::reversePacketView(const char *inputData, size_t inputLen) {
+
+	// Binary header? The ASCII header always starts with a '0' or '1', so the version byte tells them apart.
+	bool isBinary = (inputLen > 0 && inputData[0] == (char) HEADER_BINARY);
+	setHeaderVersion(isBinary ? HEADER_BINARY : HEADER_ASCII);
+
+	// The binary flags byte tells us the integrity algorithm, which decides the header size.
+	int flags = (isBinary && inputLen > 1) ? inputData[1] : 0;
+	setIntegrity(isBinary ? (flags >> 2) & 0x03 : INTEGRITY_CHECKSUM);
+	size_t headerSize = getHeaderSize(this->headerVersion, this->integrity);
+
+	// Too short to hold the header, or an ASCII header with something other than '0' / '1' in it
+	// 		(junk from anyone who connects)? Leave it with an empty payload and force a checksum failure.
+	if (inputLen < headerSize || (!isBinary && !isAsciiHeader(inputData))) {
+		setIntegrity(INTEGRITY_CHECKSUM);
+		setSeqNum(0);
+		setAck(0);
+		setChecksum(0xFFFFFFFF);
+		prepareData(0);
+		return;
+	}
+
+	if (isBinary) {
+		// Checksum (width depends on the algorithm)
+		const char *field = inputData + 2;
+		if (this->integrity == INTEGRITY_CRC32C) {
+			uint32_t netChecksum;
+			memcpy(&netChecksum, field, sizeof(netChecksum));
+			setChecksum(ntohl(netChecksum));
+			field += sizeof(netChecksum);
+		} else if (this->integrity != INTEGRITY_NONE) {
+			uint16_t netChecksum;
+			memcpy(&netChecksum, field, sizeof(netChecksum));
+			setChecksum(ntohs(netChecksum));
+			field += sizeof(netChecksum);
+		} else {
+			setChecksum(0);
+		}
+
+		uint32_t netSeqNum;
+		memcpy(&netSeqNum, field, sizeof(netSeqNum));
 
-	// Sequence Number
-	int seqNum = bitset<32>(inputData.substr(0, 32)).to_ulong();
-	setSeqNum(seqNum); 		// 32-bit sequence number
-	
-	// Acknowledgement 
-	int ackNum = bitset<2>(inputData.substr(32, 2)).to_ulong();
-	setAck(ackNum);			//1-bit ack
-	
-	// Checksum
-	u_short checkSum = bitset<16>(inputData.substr(34, 16)).to_ulong();
-	setChecksum(checkSum);	//16-bit checksum
-	
-	// Data - Need to convert to vector
-	vector<char> data(inputData.begin() + 50, inputData.end());
-	setData(data);
+		setAck(flags & 0x03);
+		setSeqNum(ntohl(netSeqNum));
+	} else {
+		// Sequence Number
+		int seqNum = bitset<32>(inputData, 32).to_ulong();
+		setSeqNum(seqNum); 		// 32-bit sequence number
+		
+		// Acknowledgement 
+		int ackNum = bitset<2>(inputData + 32, 2).to_ulong();
+		setAck(ackNum);			//1-bit ack
+		
+		// Checksum
+		u_short checkSum = bitset<16>(inputData + 34, 16).to_ulong();
+		setChecksum(checkSum);	//16-bit checksum
+	}
+
+	// Data - borrowed, not copied
+	DataView dataView = { inputData + headerSize, inputLen - headerSize };
+	setDataView(dataView);
 }
 
 /**
@@ -201,8 +616,13 @@ void Packet::reversePacket(string inputData) {
  */
 bool Packet::isValidChecksum() {
 
+	// Nothing to check?
+	if (this->headerVersion == HEADER_BINARY && this->integrity == INTEGRITY_NONE) {
+		return true;
+	}
+
 	// Calculate the checksum based off current data
-	int newChecksum = this->createChecksum();
+	unsigned int newChecksum = this->createIntegrityValue();
 
 	// Compare the stored checksum to the newly calculated one
 	if (this->checksum == newChecksum) {
@@ -213,26 +633,67 @@ bool Packet::isValidChecksum() {
 }
 
 /**
- * @brief Set and determine the timeout for the packet
+ * @brief Set the packet's retransmission timer
  * 
- * This is tied to hasTimedOut(), which indicates of the time has passed.
+ * @param timerId TimerWheel ID (-1 = none)
  */
-void Packet::setTimeout(int timeout) {
+void Packet::setTimerId(int timerId) {
+	this->timerId = timerId;
+}
 
-	// Determine the time to compare against in milliseconds
-	this->timeoutTimePoint = chrono::system_clock::now() + chrono::milliseconds(timeout);
+/**
+ * @brief The packet's retransmission timer
+ * 
+ * @return int (TimerWheel ID, -1 = none)
+ */
+int Packet::getTimerId() {
+	return this->timerId;
 }
 
 /**
- * @brief Has the packet timed out?
+ * @brief Record that the packet was (re)transmitted
+ */
+void Packet::markSent() {
+	this->sentTimePoint = chrono::steady_clock::now();
+	this->numSends++;
+}
+
+/**
+ * @brief Number of times the packet was transmitted
  * 
- * @return bool (true / false) 
+ * @return int 
  */
-bool Packet::hasTimedOut() {
+int Packet::getNumSends() {
+	return this->numSends;
+}
 
-	// Get the current timepoint.
-	chrono::system_clock::time_point curTimePoint = chrono::system_clock::now();
+/**
+ * @brief Mark whether the packet's latest resend counts against the congestion window
+ * 
+ * Only the sender's congestion window resends are counted, so only those are taken off again.
+ * 
+ * @param isCounted 
+ */
+void Packet::setResendCounted(bool isCounted) {
+	this->resendCounted = isCounted;
+}
+
+/**
+ * @brief Is the packet's latest resend counted against the congestion window?
+ * 
+ * @return bool 
+ */
+bool Packet::isResendCounted() {
+	return this->resendCounted;
+}
 
-	// Compare the times. If the timeout time point has passed, then we have timed out the packet.
-	return (curTimePoint > timeoutTimePoint);
-}
\ No newline at end of file
+/**
+ * @brief Time since the latest transmission
+ * 
+ * Only a true round trip for packets sent once - with retransmissions we can't tell which copy was ACK'd.
+ * 
+ * @return long long (microseconds)
+ */
+long long Packet::getMicrosSinceSent() {
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - this->sentTimePoint).count();
+}
@@ -2,22 +2,80 @@
 #include <iostream>
 #include <chrono>
 #include <vector>
+#include <atomic>
+#include <memory>
 using namespace std;
+#ifndef PACKET_H
+#define PACKET_H
+
+/**
+ * A borrowed region of memory (packet data living in someone else's buffer)
+ */
+struct DataView {
+	const char *data;
+	size_t size;
+};
+
 class Packet {
 	private: 
 		unsigned int seqNum;		// Packet sequence number
 		int seqNumRange = 0;    // Sequence number range (0 = no range)
 		int ack = 0;		// Acknowledgement (0 = None, 1 = OK, 2 = FAIL)
-		int checksum;	// Current Checksum
-		vector <char> data;	// Packet data or file name (initial packet only)
-		chrono::system_clock::time_point timeoutTimePoint;	// Time that the packet times out.
+		unsigned int checksum;	// Current Checksum (or CRC-32C)
+		int headerVersion = 1;	// Wire header format (HEADER_ASCII or HEADER_BINARY)
+		int integrity = 0;	// Integrity algorithm (INTEGRITY_X) - binary header only
+		vector <char> data;	// Packet data or file name (initial packet only) - when no slab is attached
+		char *slab = nullptr;		// Pool-provided data buffer (see PacketPool)
+		size_t slabCapacity = 0;	// Size of the slab
+		size_t slabDataSize = 0;	// Bytes of data in the slab
+		DataView borrowedData = { nullptr, 0 };	// Data borrowed from another buffer (see setDataView)
+		int dataSource = 0;			// Where the data lives (DATA_X)
+		shared_ptr<string> frame;		// Cached packet string (storage is reused once the packet changes)
+		shared_ptr<string> nackFrame;	// Cached packet string with a forced checksum failure
+		bool hasFrame = false;			// Is the cached packet string current?
+		bool hasNackFrame = false;		// Is the cached NACK packet string current?
+		int timerId = -1;		// Retransmission timer (TimerWheel ID, -1 = none)
+		chrono::steady_clock::time_point sentTimePoint;		// Time of the latest transmission
+		int numSends = 0;		// Transmissions so far (original + retransmissions)
+		bool resendCounted = false;	// Is its latest resend counted against the congestion window? (sender)
 
 	public:
 		static const int ACK_OK = 1;
 		static const int ACK_FAIL = 2;
 
+		// Where the packet data lives
+		static const int DATA_VECTOR = 0;	// Owned - the packet's vector
+		static const int DATA_SLAB = 1;		// Owned - the pool slab
+		static const int DATA_VIEW = 2;		// Borrowed - valid only as long as the lender's buffer
+
+		// Wire header formats
+		// - HEADER_ASCII:  50 '0'/'1' characters (32-bit seq, 2-bit ack, 16-bit checksum)
+		// - HEADER_BINARY: packed bytes in network byte order (version, ack + integrity, checksum, seq)
+		//                  8 bytes with the checksum, 10 with CRC-32C, 6 with no integrity check
+		static const int HEADER_ASCII = 1;
+		static const int HEADER_BINARY = 2;
+		static const int HEADER_ASCII_SIZE = 50;
+		static const int HEADER_BINARY_SIZE = 8;
+
+		// Integrity algorithms (negotiated in the initial packet)
+		static const int INTEGRITY_CHECKSUM = 0;	// 16-bit one's-complement checksum
+		static const int INTEGRITY_CRC32C = 1;		// 32-bit CRC-32C
+		static const int INTEGRITY_NONE = 2;		// No check (trusted links / benchmarking)
+
 		Packet();
 
+		// Header Format
+		void setHeaderVersion(int headerVersion);
+		int getHeaderVersion();
+		static int getHeaderSize(int headerVersion, int integrity = INTEGRITY_CHECKSUM);
+
+		// Integrity Algorithm
+		void setIntegrity(int integrity);
+		int getIntegrity();
+		static string getIntegrityName(int integrity);
+		static long long getIntegrityTimeNS();
+		static long long getIntegrityBytes();
+
 		// Sequence Number
 		void setSeqNum(int seqNum);
 		int getSeqNum();
@@ -34,12 +92,28 @@ class Packet {
 		// File Data
 		void setData(vector <char> data);
 		vector <char> getData();
+		const char *getDataPtr();
+		size_t getDataSize();
+		char *prepareData(size_t dataSize);
+		void attachSlab(char *slab, size_t slabCapacity);
+
+		// Borrowed Data (no copies until ownData() is called)
+		void setDataView(DataView dataView);
+		DataView getDataView();
+		bool isDataBorrowed();
+		void ownData();
+		static long long getBytesCopied();
+		static long long getThreadBytesCopied();
+
+		// Return the packet to a blank state (keeps the slab and frame storage for reuse)
+		void reset();
 
 		// Checksum
 		u_short createChecksum();
+		unsigned int createIntegrityValue();
 		bool isValidChecksum();
-		void setChecksum(int checksum);
-		int getChecksum();
+		void setChecksum(unsigned int checksum);
+		unsigned int getChecksum();
 
 		// Acknowledgement
 		void setAck(int ack);
@@ -48,10 +122,26 @@ class Packet {
 		// Packet creation / reversal
 		string createPacketString(bool forceNACK);
 		string createPacketString();
+		void writePacketString(string &pktString, bool forceNACK);
 		void reversePacket(string inputData);
+		void reversePacketView(const char *inputData, size_t inputLen);
 
-		// Packet Timeout
-		void setTimeout(int timeout);
-		bool hasTimedOut();
+		// Cached packet string - built once and shared by every (re)transmission
+		shared_ptr<const string> getFrame(bool forceNACK = false);
+		void clearFrame();
+		static long long getFrameBytesSaved();
+
+		// Packet Timeout (the timer lives in the sender's TimerWheel)
+		void setTimerId(int timerId);
+		int getTimerId();
+
+		// Transmission tracking (for ACK latency)
+		void markSent();
+		int getNumSends();
+		void setResendCounted(bool isCounted);
+		bool isResendCounted();
+		long long getMicrosSinceSent();
 
 };
+
+#endif
@@ -0,0 +1,124 @@
+#include <memory>
+#include <vector>
+#include "PacketPool.h"
+using namespace std;
+
+/**
+ * @brief Empty pool - every packet comes from the heap until reserve() is called
+ */
+PacketPool::PacketPool() {
+}
+
+/**
+ * @brief Create a pool of packets
+ *
+ * @param capacity Number of packets
+ * @param slabSize Max data bytes per packet
+ */
+PacketPool::PacketPool(int capacity, size_t slabSize) {
+	this->reserve(capacity, slabSize);
+}
+
+/**
+ * @brief Allocate the packets and the arena that backs their data
+ *
+ * This is the only place the pool allocates. It must not be called while pooled packets are in use.
+ */
+void PacketPool::reserve(int capacity, size_t slabSize) {
+	this->capacity = capacity;
+	this->slabSize = slabSize;
+	this->packets.reset(new Packet[capacity]);
+	this->arena.assign((size_t) capacity * slabSize, 0);
+	this->freeSlots.clear();
+	this->freeSlots.reserve(capacity);
+
+	// Carve one slab per packet. Push in reverse so slot 0 is handed out first.
+	for (int i = capacity - 1; i >= 0; i--) {
+		this->packets[i].attachSlab(this->arena.data() + (size_t) i * slabSize, slabSize);
+		this->freeSlots.push_back(i);
+	}
+}
+
+/**
+ * @brief Get a blank packet
+ *
+ * @return PacketPool::Handle (returns itself to the pool when destroyed)
+ */
+PacketPool::Handle PacketPool::acquire() {
+	Releaser releaser = { this };
+	this->numAcquired++;
+
+	// Pool ran dry? Use the heap so the transfer keeps going, but keep count.
+	if (this->freeSlots.empty()) {
+		this->numHeapAllocs++;
+		return Handle(new Packet(), releaser);
+	}
+
+	int slot = this->freeSlots.back();
+	this->freeSlots.pop_back();
+
+	return Handle(&this->packets[slot], releaser);
+}
+
+/**
+ * @brief Return a packet to the pool (or free it if it came from the heap)
+ */
+void PacketPool::release(Packet *packet) {
+	Packet *firstPacket = this->packets.get();
+
+	if (firstPacket != nullptr && packet >= firstPacket && packet < firstPacket + this->capacity) {
+		packet->reset();
+		this->freeSlots.push_back(packet - firstPacket);
+	} else {
+		delete packet;
+	}
+}
+
+/**
+ * @brief Releaser used by PacketPool::Handle
+ */
+void PacketPool::Releaser::operator()(Packet *packet) const {
+	this->pool->release(packet);
+}
+
+/**
+ * @brief Start of the arena the data slabs are carved from
+ */
+char *PacketPool::getArena() {
+	return this->arena.data();
+}
+
+/**
+ * @brief Size of the arena
+ */
+size_t PacketPool::getArenaSize() {
+	return this->arena.size();
+}
+
+/**
+ * @brief Number of packets in the pool
+ */
+int PacketPool::getCapacity() {
+	return this->capacity;
+}
+
+/**
+ * @brief Number of pooled packets not in use
+ */
+int PacketPool::getNumFree() {
+	return this->freeSlots.size();
+}
+
+/**
+ * @brief Number of packets handed out
+ */
+long long PacketPool::getNumAcquired() {
+	return this->numAcquired;
+}
+
+/**
+ * @brief Number of packets that had to be allocated on the heap
+ */
+long long PacketPool::getNumHeapAllocs() {
+	return this->numHeapAllocs;
+}
@@ -0,0 +1,58 @@
+#include <memory>
+#include <vector>
+#include "Packet.h"
+using namespace std;
+#ifndef PACKETPOOL_H
+#define PACKETPOOL_H
+
+/**
+ * Packet Pool
+ *
+ * A fixed number of packets (sized from the sliding window) whose data slabs are carved out of
+ * 		one arena. Acquiring and releasing a packet never touches the heap; if the pool runs dry
+ * 		we fall back to a heap packet and count it so it shows up in the statistics.
+ *
+ * Not thread-safe - acquire and release from one thread (or under the caller's lock).
+ */
+class PacketPool {
+
+	private:
+		unique_ptr<Packet[]> packets;	// Pooled packets
+		vector<char> arena;				// Data slabs, slabSize bytes each
+		vector<int> freeSlots;			// Indexes of packets that are available
+		int capacity = 0;
+		size_t slabSize = 0;
+
+		// Statistics
+		long long numAcquired = 0;		// Packets handed out (pool + heap)
+		long long numHeapAllocs = 0;	// Packets that had to come from the heap
+
+	public:
+		// Returns packets to the pool they came from (or deletes heap packets)
+		struct Releaser {
+			PacketPool *pool;
+			void operator()(Packet *packet) const;
+		};
+		typedef unique_ptr<Packet, Releaser> Handle;
+
+		PacketPool();
+		PacketPool(int capacity, size_t slabSize);
+
+		// Size the pool (only while no pooled packets are in use)
+		void reserve(int capacity, size_t slabSize);
+
+		Handle acquire();
+		void release(Packet *packet);
+
+		// Memory backing the pooled packets' data (e.g. to register for async I/O)
+		char *getArena();
+		size_t getArenaSize();
+
+		// Statistics
+		int getCapacity();
+		int getNumFree();
+		long long getNumAcquired();
+		long long getNumHeapAllocs();
+};
+
+#endif
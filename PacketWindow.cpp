@@ -0,0 +1,104 @@
+#include <vector>
+#include <algorithm>
+#include "PacketWindow.h"
+using namespace std;
+
+/**
+ * @brief Empty window - reserve() before use
+ */
+PacketWindow::PacketWindow() {
+}
+
+/**
+ * @brief Size the ring for a window
+ *
+ * Rounds up to a power of two so the slot is just the low bits of the sequence number (at most
+ * 		MAX_CAPACITY - callers keep their windows well below it).
+ */
+void PacketWindow::reserve(int windowSize) {
+	uint32_t capacity = 1;
+	while (capacity < (uint32_t) max(1, windowSize) && capacity < MAX_CAPACITY) {
+		capacity <<= 1;
+	}
+
+	this->slots.clear();
+	this->slots.resize(capacity);
+	this->usedSlots.assign((capacity + 63) / 64, 0);
+	this->mask = capacity - 1;
+	this->count = 0;
+}
+
+/**
+ * @brief Does a slot hold a packet?
+ */
+bool PacketWindow::isUsed(uint32_t slot) {
+	return (this->usedSlots[slot >> 6] >> (slot & 63)) & 1;
+}
+
+/**
+ * @brief Is the packet with this sequence number in the window?
+ *
+ * The slot may hold a later packet (e.g. a late ACK for one that's already gone), so the
+ * 		sequence number has to match too.
+ */
+bool PacketWindow::has(int seqNum) {
+	uint32_t slot = (uint32_t) seqNum & this->mask;
+	return !this->slots.empty() && this->isUsed(slot) && this->slots[slot]->getSeqNum() == seqNum;
+}
+
+/**
+ * @brief The packet with this sequence number
+ *
+ * @return Packet* (nullptr if it isn't in the window)
+ */
+Packet *PacketWindow::get(int seqNum) {
+	if (!this->has(seqNum)) {
+		return nullptr;
+	}
+	return this->slots[(uint32_t) seqNum & this->mask].get();
+}
+
+/**
+ * @brief Add a packet to its slot
+ *
+ * The slot must be free - i.e. the window never holds more than the capacity's worth of
+ * 		sequence numbers.
+ */
+void PacketWindow::put(PacketPool::Handle packet) {
+	uint32_t slot = (uint32_t) packet->getSeqNum() & this->mask;
+
+	this->slots[slot] = move(packet);
+	this->usedSlots[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+	this->count++;
+}
+
+/**
+ * @brief Take the packet with this sequence number out of the window
+ *
+ * @return PacketPool::Handle (empty if it isn't in the window)
+ */
+PacketPool::Handle PacketWindow::take(int seqNum) {
+	if (!this->has(seqNum)) {
+		return PacketPool::Handle();
+	}
+
+	uint32_t slot = (uint32_t) seqNum & this->mask;
+	this->usedSlots[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+	this->count--;
+
+	return move(this->slots[slot]);
+}
+
+/**
+ * @brief Number of packets in the window
+ */
+int PacketWindow::size() {
+	return this->count;
+}
+
+/**
+ * @brief Number of slots in the ring
+ */
+int PacketWindow::getCapacity() {
+	return this->mask + 1;
+}
@@ -0,0 +1,53 @@
+#include <vector>
+#include <stdint.h>
+#include "Packet.h"
+#include "PacketPool.h"
+using namespace std;
+#ifndef PACKETWINDOW_H
+#define PACKETWINDOW_H
+
+/**
+ * Packet Window
+ *
+ * The packets in a sliding window, kept in a ring indexed by sequence number. The capacity is a
+ * 		power of two at least as big as the window, so a packet's slot is its sequence number
+ * 		masked by (capacity - 1) and no two packets in the window ever share one. A bitmap marks
+ * 		the slots in use.
+ *
+ * Finding, adding and taking out a packet are O(1), whatever the size of the window.
+ *
+ * Not thread-safe - use from one thread (or under the caller's lock).
+ */
+class PacketWindow {
+
+	private:
+		vector<PacketPool::Handle> slots;
+		vector<uint64_t> usedSlots;		// Bit per slot - set = holds a packet
+		uint32_t mask = 0;				// Capacity - 1
+		int count = 0;
+
+		bool isUsed(uint32_t slot);
+
+	public:
+		static const uint32_t MAX_CAPACITY = 1u << 30;	// Biggest ring (bigger windows share slots)
+
+		PacketWindow();
+
+		// Size the ring for a window (only while it's empty)
+		void reserve(int windowSize);
+
+		// Is the packet with this sequence number in the window?
+		bool has(int seqNum);
+
+		// The packet with this sequence number (nullptr if it isn't in the window)
+		Packet *get(int seqNum);
+
+		// Add a packet (its slot must be free) / take it back out
+		void put(PacketPool::Handle packet);
+		PacketPool::Handle take(int seqNum);
+
+		int size();
+		int getCapacity();
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <algorithm>
+#include "RTOEstimator.h"
+using namespace std;
+
+/**
+ * @brief No samples yet - the timeout is INITIAL_RTO_MS
+ */
+RTOEstimator::RTOEstimator() {
+}
+
+/**
+ * @brief Timeout is at least this many smoothed RTTs
+ */
+void RTOEstimator::setRttFactor(int rttFactor) {
+	this->rttFactor = max(1, rttFactor);
+}
+
+/**
+ * @brief Timeout before any backoff
+ */
+long long RTOEstimator::getBaseTimeoutUS() {
+	if (!this->hasSample) {
+		return INITIAL_RTO_MS * 1000LL;
+	}
+
+	double timeoutUS = max(this->smoothedUS + 4 * this->varianceUS, this->rttFactor * this->smoothedUS);
+	return max((long long) MIN_RTO_MS * 1000, (long long) timeoutUS);
+}
+
+/**
+ * @brief Round trip of a packet sent once
+ *
+ * The first sample sets the smoothed RTT and half of it as the variance. After that, each one
+ * 		moves the variance 1/4 and the smoothed RTT 1/8 of the way towards it.
+ */
+void RTOEstimator::addSample(long long rttUS) {
+	if (!this->hasSample) {
+		this->smoothedUS = rttUS;
+		this->varianceUS = rttUS / 2.0;
+		this->hasSample = true;
+	} else {
+		double deviationUS = this->smoothedUS - rttUS;
+		this->varianceUS += (((deviationUS < 0) ? -deviationUS : deviationUS) - this->varianceUS) / 4;
+		this->smoothedUS += (rttUS - this->smoothedUS) / 8;
+	}
+
+	// A clean sample - the path is answering again
+	this->numBackoffs = 0;
+	this->numSamples++;
+}
+
+/**
+ * @brief A timeout went off - double the timeout until the next sample
+ */
+void RTOEstimator::backOff() {
+	if ((this->getBaseTimeoutUS() << this->numBackoffs) < MAX_RTO_MS * 1000LL) {
+		this->numBackoffs++;
+	}
+	this->totalBackoffs++;
+}
+
+/**
+ * @brief How long to wait for an ACK before retransmitting
+ */
+chrono::microseconds RTOEstimator::getTimeout() {
+	long long timeoutUS = min(this->getBaseTimeoutUS() << this->numBackoffs, MAX_RTO_MS * 1000LL);
+	this->maxTimeoutUS = max(this->maxTimeoutUS, timeoutUS);
+
+	return chrono::microseconds(timeoutUS);
+}
+
+/**
+ * @brief Smoothed RTT (us)
+ */
+double RTOEstimator::getSmoothedUS() {
+	return this->smoothedUS;
+}
+
+/**
+ * @brief RTT variance (us)
+ */
+double RTOEstimator::getVarianceUS() {
+	return this->varianceUS;
+}
+
+/**
+ * @brief Number of round trips sampled
+ */
+long long RTOEstimator::getNumSamples() {
+	return this->numSamples;
+}
+
+/**
+ * @brief Number of times the timeout was doubled
+ */
+long long RTOEstimator::getNumBackoffs() {
+	return this->totalBackoffs;
+}
+
+/**
+ * @brief Longest timeout handed out (us)
+ */
+long long RTOEstimator::getMaxTimeoutUS() {
+	return this->maxTimeoutUS;
+}
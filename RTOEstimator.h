@@ -0,0 +1,60 @@
+#include <chrono>
+using namespace std;
+#ifndef RTOESTIMATOR_H
+#define RTOESTIMATOR_H
+
+/**
+ * RTO Estimator
+ *
+ * Retransmission timeout from the round trips seen so far (Jacobson/Karels, as in RFC 6298):
+ * 		a smoothed RTT and RTT variance, updated with every sample, give
+ * 		timeout = smoothed + 4 * variance (at least MIN_RTO_MS).
+ *
+ * Only packets sent once are sampled (Karn's rule) - an ACK for a retransmitted packet could be
+ * 		for either send. Every timeout doubles the timeout (up to MAX_RTO_MS) until the next
+ * 		sample comes in.
+ *
+ * Not thread-safe - use from one thread (or under the caller's lock).
+ */
+class RTOEstimator {
+
+	public:
+		static const int INITIAL_RTO_MS = 1000;	// Before the first sample
+		static const int MIN_RTO_MS = 4;
+		static const int MAX_RTO_MS = 60000;
+
+	private:
+		bool hasSample = false;
+		double smoothedUS = 0;			// Smoothed RTT
+		double varianceUS = 0;			// RTT variance (mean deviation)
+		int rttFactor = 1;				// Timeout is at least this many smoothed RTTs
+		int numBackoffs = 0;			// Timeouts since the last sample
+
+		// Statistics
+		long long numSamples = 0;
+		long long totalBackoffs = 0;
+		long long maxTimeoutUS = 0;
+
+		long long getBaseTimeoutUS();
+
+	public:
+		RTOEstimator();
+
+		// Timeout is at least this many smoothed RTTs (default 1)
+		void setRttFactor(int rttFactor);
+
+		// Round trip of a packet sent once / a timeout went off
+		void addSample(long long rttUS);
+		void backOff();
+
+		chrono::microseconds getTimeout();
+
+		// Statistics
+		double getSmoothedUS();
+		double getVarianceUS();
+		long long getNumSamples();
+		long long getNumBackoffs();
+		long long getMaxTimeoutUS();
+};
+
+#endif
@@ -0,0 +1,693 @@
+#include <memory>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ReceiverSession.h"
+#include "SessionSetup.h"
+#include "Checksum.h"
+using namespace std;
+/**
+ * Receiver Session
+ *
+ * One transfer from one sender: reads its frames, ACKs them and reconstructs the file.
+ */
+
+/**
+ * @brief Start a session (the caller sets up the connection with getSocket())
+ */
+ReceiverSession::ReceiverSession(int sessionId) {
+	this->sessionId = sessionId;
+	this->startTimePoint = chrono::steady_clock::now();
+
+	// File writes - io_uring if we have it
+	this->fileIO.init(2 * MAX_PENDING_WRITES);
+}
+
+/**
+ * @brief Set the ACK policy (selective ACKs)
+ *
+ * @param ackEvery 	ACK once this many packets arrived (1 = every packet)
+ * @param ackDelayMS Longest a packet waits for its ACK
+ */
+void ReceiverSession::setAckPolicy(int ackEvery, int ackDelayMS) {
+	this->ackEvery = max(1, ackEvery);
+	this->ackDelayMS = max(0, ackDelayMS);
+}
+
+/**
+ * @brief The session's connection
+ */
+NetSocket &ReceiverSession::getSocket() {
+	return this->clientSocket;
+}
+
+/**
+ * @brief The session's number (for output)
+ */
+int ReceiverSession::getSessionId() {
+	return this->sessionId;
+}
+
+/**
+ * @brief Has every packet of the file been received?
+ */
+bool ReceiverSession::isComplete() {
+	return this->numPackets > 0 && this->curPktNum == this->numPackets;
+}
+
+/**
+ * @brief Size of the file being transferred
+ */
+long long ReceiverSession::getFileSize() {
+	return this->fileSize;
+}
+
+/**
+ * @brief Read the initial packet
+ *
+ * The data is a list of session setup options (see SessionSetup). Anything we don't recognize is skipped.
+ *
+ * @return bool (false = the session was rejected - it asks for a window, packets or memory over our limits)
+ */
+bool ReceiverSession::readInitialPacket(DataView rawPacketData) {
+
+	SessionSetup offer;
+	if (!offer.decode(rawPacketData.data, rawPacketData.size)) {
+		cout << "Initial packet has an unknown format\n";
+	}
+
+	fileSize = max(0LL, offer.fileSize);
+	numPackets = max(0LL, offer.numPackets);
+	packetSize = max(0, offer.packetSize);
+	slidingWindowSize = max(1, offer.windowSize);
+	protocol = offer.protocol;
+	goBackN = (protocol == "GBN");
+	seqNumRange = max(0, offer.seqNumRange);
+	outputFileName = offer.fileName;
+
+	// The header format the sender offers - we accept binary, anything else stays ASCII.
+	headerVersion = (offer.headerVersion == Packet::HEADER_BINARY) ? Packet::HEADER_BINARY : Packet::HEADER_ASCII;
+
+	// The integrity check the sender offers - any we know about works with the binary header.
+	if (headerVersion == Packet::HEADER_BINARY && offer.integrity >= Packet::INTEGRITY_CHECKSUM && offer.integrity <= Packet::INTEGRITY_NONE) {
+		integrity = offer.integrity;
+	}
+
+	// Capabilities we support - selective ACKs only make sense with a buffer (SR)
+	capabilities = offer.capabilities & SessionSetup::CAP_SACK;
+	if (goBackN) {
+		capabilities &= ~SessionSetup::CAP_SACK;
+	}
+	selectiveAcks = (capabilities & SessionSetup::CAP_SACK) != 0;
+
+	// The window and packet size come off the network - don't let them size the buffers past what we can give
+	if (slidingWindowSize > MAX_WINDOW_SIZE || packetSize > MAX_PACKET_SIZE) {
+		cout << "Session " << sessionId << " rejected: window of " << slidingWindowSize << " packets of " << packetSize
+			<< " bytes (at most " << MAX_WINDOW_SIZE << " packets of " << MAX_PACKET_SIZE << " bytes)\n";
+		rejected = true;
+		return false;
+	}
+
+	// Every session shares the process - one asking for too much memory would take the others down with it.
+	// (The pool takes a packet and its data per slot, the reorder buffer's ring up to two handles per window slot.)
+	long long sessionMemory = (long long) (slidingWindowSize + 1 + MAX_PENDING_WRITES) * (packetSize + sizeof(Packet))
+		+ 2LL * slidingWindowSize * sizeof(PacketPool::Handle);
+	if (sessionMemory > MAX_SESSION_MEMORY) {
+		cout << "Session " << sessionId << " rejected: window of " << slidingWindowSize << " packets of " << packetSize
+			<< " bytes needs " << sessionMemory / (1024 * 1024) << "MB (at most " << MAX_SESSION_MEMORY / (1024 * 1024) << "MB per session)\n";
+		rejected = true;
+		return false;
+	}
+
+	// Open up the file for writing
+	senderFile = open(outputFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (senderFile < 0) {
+		cout << "Cannot Open File: " << outputFileName << "\n";
+	}
+
+	// One pooled packet per window slot, plus the one being read from the socket and the ones being written
+	packetPool.reserve(slidingWindowSize + 1 + MAX_PENDING_WRITES, packetSize);
+	packetBuffer.reserve(slidingWindowSize);
+	fileIO.registerBuffer(packetPool.getArena(), packetPool.getArenaSize());
+
+	// TODO: Check for existence
+	cout << "File Details: " << outputFileName << " | Size: " << to_string(fileSize) << "\n"
+		<< "# Packets: " << to_string(numPackets) << " | Packet Size: " << to_string(packetSize)
+		<< " | Window Size: " << to_string(slidingWindowSize) << " | Protocol: " << protocol
+		<< " | Header: " << ((headerVersion == Packet::HEADER_BINARY) ? "Binary" : "ASCII")
+		<< " | Integrity: " << Packet::getIntegrityName(integrity) << "\n";
+
+	if (offer.numUnknownOptions > 0) {
+		cout << "Skipped " << offer.numUnknownOptions << " unknown session option(s)\n";
+	}
+
+	return true;
+}
+
+/**
+ * @brief Return packets whose file writes finished to the pool
+ *
+ * @param wait Wait for at least one write to finish
+ */
+void ReceiverSession::reapFileWrites(bool wait) {
+	AsyncIO::Completion completion;
+
+	while (fileIO.getCompletion(completion, wait)) {
+		wait = false;
+
+		if (completion.result < 0) {
+			cout << "Write Failed: " << strerror(-completion.result) << "\n";
+		}
+
+		// The tag is the packet
+		for (vector<PacketPool::Handle>::iterator iterator = pendingWrites.begin(); iterator != pendingWrites.end(); ++iterator) {
+			if ((uint64_t) (uintptr_t) iterator->get() == completion.tag) {
+				pendingWrites.erase(iterator);
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Write the packet's data as the next piece of the file
+ *
+ * With io_uring the write runs in the background (submitted with the rest of the batch once we're
+ * 		about to wait on the socket), so the packet has to hold its own copy of the data until then.
+ * 		The synchronous engine writes straight from the frame.
+ */
+void ReceiverSession::writeFileData(PacketPool::Handle packet) {
+	if (fileIO.getEngine() == AsyncIO::ENGINE_IO_URING) {
+		long long copiedBefore = Packet::getThreadBytesCopied();
+		packet->ownData();
+		bytesCopied += Packet::getThreadBytesCopied() - copiedBefore;
+	}
+
+	DataView fileData = packet->getDataView();
+	if (!fileIO.submitWrite(senderFile, fileData.data, fileData.size, fileWriteOffset, (uint64_t) (uintptr_t) packet.get())) {
+		cout << "Write Failed: the I/O engine stopped working\n";
+		return;
+	}
+	fileWriteOffset += fileData.size;
+	pendingWrites.push_back(move(packet));
+
+	// Too many in flight? Wait for one.
+	if (pendingWrites.size() >= MAX_PENDING_WRITES) {
+		reapFileWrites(true);
+	}
+}
+
+/**
+ * @brief Process the packet buffer
+ *
+ * After every packet is received, which precedes this function, we want to go through the
+ * 		buffer of stored packets to reconstruct the file. This method works by comparing
+ * 		the packet we *should* be on with the ones stored in the buffer. If we're ready to move
+ * 		forward, it'll write to the file and see if we should move onto the next packet in the buffer
+ *
+ * The buffer is indexed by sequence number, so each step is a single slot lookup.
+ */
+void ReceiverSession::processPacketBuffer() {
+	// Keep going while the packet we're waiting for is in the buffer
+	while (packetBuffer.has(curPktNum)) {
+
+		// Add the data (straight from the packet - no copy)
+		writeFileData(packetBuffer.take(curPktNum));
+
+		// We can move onto the next packet.
+		curPktNum++;
+	}
+}
+
+/**
+ * @brief Send back an ACK packet
+ *
+ * This sends a packet back to the client connection.
+ *
+ * The ACK uses the same header format and integrity check as the packet it acknowledges, so the ACK for the
+ * 		initial packet is still understood by a sender that has not switched formats yet.
+ *
+ * @param seqNum 		Sequence number of the packet
+ * @param validChecksum Checksum status (true = valid, false = invalid)
+ * @param ackHeaderVersion Header format to reply with
+ * @param ackIntegrity 	Integrity check to reply with
+ * @param withBitmap	Selective ACK - the data is a bitmap of the packets after seqNum that we have (bit i = seqNum + 1 + i)
+ */
+void ReceiverSession::sendAckMessage(int seqNum, bool validChecksum, int ackHeaderVersion, int ackIntegrity, bool withBitmap) {
+
+	// Build the packet (no data needed, just sequence # and ack state)
+	ackPacket.setHeaderVersion(ackHeaderVersion);
+	ackPacket.setIntegrity(ackIntegrity);
+	ackPacket.setSeqNum(seqNum);
+	ackPacket.setSeqNumRange(seqNumRange);
+	ackPacket.setAck((validChecksum) ? Packet::ACK_OK : Packet::ACK_FAIL);
+
+	// A selective ACK carries the bitmap, and the initial packet's ACK the session options we accepted.
+	if (withBitmap) {
+		// Everything from curPktNum (missing - or it'd be written already) up to the highest packet buffered
+		int numBits = min(lastPktNum - seqNum, slidingWindowSize);
+		int numBytes = max(1, (numBits + 7) / 8);
+		char *bitmap = ackPacket.prepareData(numBytes);
+		memset(bitmap, 0, numBytes);
+
+		for (int i = 0; i < numBits; i++) {
+			if (packetBuffer.has(seqNum + 1 + i)) {
+				bitmap[i >> 3] |= (char) (1 << (i & 7));
+			}
+		}
+	} else if (seqNum == 0) {
+		SessionSetup accepted;
+		accepted.headerVersion = headerVersion;
+		accepted.integrity = integrity;
+		accepted.capabilities = capabilities;
+
+		string acceptedData = accepted.encode();
+		memcpy(ackPacket.prepareData(acceptedData.length()), acceptedData.data(), acceptedData.length());
+	} else {
+		ackPacket.prepareData(1)[0] = 0;
+	}
+
+	// Queue the ACK - processFrames() sends the queue before it waits on the socket again.
+	// Only a frame cache miss copies the data
+	long long copiedBefore = Packet::getThreadBytesCopied();
+	clientSocket.queueFrame(ackPacket.getFrame());
+	bytesCopied += Packet::getThreadBytesCopied() - copiedBefore;
+	numAcksSent++;
+}
+
+/**
+ * @brief Queue the cumulative ACK we owe the sender (if any)
+ *
+ * It names the last packet received in order. A selective ACK also carries the bitmap of the
+ * 		packets buffered after it, so any one of them tells the sender everything we have.
+ */
+void ReceiverSession::sendPendingAck() {
+	if (cumulativeAckPending) {
+		cumulativeAckPending = false;
+		ackImmediately = false;
+		numUnacked = 0;
+		sendAckMessage(curPktNum - 1, true, cumulativeAckHeaderVersion, cumulativeAckIntegrity, selectiveAcks);
+		cout << "Ack " << ackPacket.showSeqNum() << " sent (" << ((selectiveAcks) ? "selective" : "cumulative") << ")\n";
+	}
+}
+
+/**
+ * @brief Is the selective ACK we owe due? (see setAckPolicy())
+ */
+bool ReceiverSession::isAckDue() {
+	// Never hold more than half the window - the sender would run out of room waiting on the timer
+	int maxUnacked = max(1, min(ackEvery, slidingWindowSize / 2));
+
+	return cumulativeAckPending && (ackImmediately || numUnacked >= maxUnacked || chrono::steady_clock::now() >= ackDeadline);
+}
+
+/**
+ * @brief When the delayed ACK we owe is due
+ *
+ * @return bool (false = we don't owe one)
+ */
+bool ReceiverSession::getAckDeadline(chrono::steady_clock::time_point &deadline) {
+	if (!cumulativeAckPending || goBackN) {
+		return false;
+	}
+
+	deadline = ackDeadline;
+	return true;
+}
+
+/**
+ * @brief Send the delayed ACK if it's due (the caller waited until getAckDeadline())
+ */
+void ReceiverSession::sendDelayedAck() {
+	if (isAckDue()) {
+		sendPendingAck();
+		clientSocket.flushQueue();
+	}
+}
+
+/**
+ * @brief Send the queued ACKs
+ *
+ * With Go-Back-N, this is where the cumulative ACK goes out - one for everything received since
+ * 		the last time, instead of one per packet. A selective ACK only goes out once it's due.
+ */
+void ReceiverSession::flushAcks() {
+	if (goBackN || isAckDue()) {
+		sendPendingAck();
+	}
+	clientSocket.flushQueue();
+}
+
+/**
+ * @brief Show the sliding window on the receiver side
+ *
+ * The windows shifts after each ACK.
+ * Selective Repeat = Size = N | Go-Back-N = 1
+ * Example: [1, 2, 3, 4, 5]
+ *
+ * Big windows only show their ends (e.g. [1, 2, 3, 4, ..., 65536]).
+ */
+void ReceiverSession::showSlidingWindow() {
+
+	int slidingWindowFront = curPktNum + 1; // Our sliding number is based on *after* ACK is sent.
+
+    // Create the window display
+    int slidingWindowMax = slidingWindowFront + slidingWindowSize - 1;
+    string windowDisplay = "Current window = [";
+    for (int i = slidingWindowFront; i <= slidingWindowMax; i++) {
+
+        // Too many to show? Skip to the last one.
+        if (slidingWindowSize > MAX_WINDOW_DISPLAY && i == slidingWindowFront + 4) {
+            windowDisplay.append("..., ");
+            i = slidingWindowMax;
+        }
+
+        // Display the number (how depends on range)
+        if (seqNumRange > 0) {
+            windowDisplay.append(to_string(i % seqNumRange));
+        } else {
+            windowDisplay.append(to_string(i));
+        }
+
+        if (i != slidingWindowMax) {
+            windowDisplay.append(", ");
+        }
+    }
+    windowDisplay.append("]");
+
+    // Display the full window - we do this at the end to prevent delays in cout.
+    printf("%s\n", windowDisplay.c_str());
+}
+
+/**
+ * @brief Keep acknowledging after the transfer is done (UDP)
+ *
+ * Our final ACKs may have been lost, in which case the sender keeps retransmitting. Everything that
+ * 		arrives now is a duplicate, so we just ACK it - until the sender says it's done or goes quiet.
+ */
+void ReceiverSession::lingerForSender() {
+	Packet dupPacket = Packet();
+	const char *frameData;
+	size_t frameLen;
+
+	while (clientSocket.waitForData(UDP_LINGER_MS) && clientSocket.getFrame(frameData, frameLen)) {
+
+		// The sender got all of our ACKs
+		if (frameLen == 4 && memcmp(frameData, "DONE", 4) == 0) {
+			break;
+		}
+
+		if (frameLen == 4 && memcmp(frameData, "PING", 4) == 0) {
+			clientSocket.sendData("PING");
+			continue;
+		}
+
+		dupPacket.reversePacketView(frameData, frameLen);
+		dupPacket.setSeqNumRange(seqNumRange);
+		sendAckMessage(dupPacket.getSeqNum(), dupPacket.isValidChecksum(), dupPacket.getHeaderVersion(), dupPacket.getIntegrity());
+		cout << "Ack " << dupPacket.showSeqNum() << " sent (duplicate)\n";
+
+		if (!clientSocket.hasBufferedFrame()) {
+			clientSocket.flushQueue();
+		}
+	}
+}
+
+/**
+ * @brief Handle every frame we can get without waiting
+ *
+ * With a blocking socket this runs until the transfer is over. With a non-blocking one it returns
+ * 		once the socket runs dry, and is called again when more data arrives.
+ *
+ * @return bool (false = the transfer is over - done, or the connection closed)
+ */
+bool ReceiverSession::processFrames() {
+	while (1) {
+		// Nothing left to read without waiting? Send the ACKs we've queued up and start the file writes first.
+		if (!clientSocket.hasBufferedFrame()) {
+
+			// Blocking and owe a delayed ACK? Only wait for more data until it's due.
+			// - Non-blocking sessions return below, and their worker wakes them up for it.
+			chrono::steady_clock::time_point deadline;
+			if (!clientSocket.isNonBlocking() && getAckDeadline(deadline)) {
+				long long waitMS = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count() + 1;
+				clientSocket.waitForData((int) max(0LL, waitMS));
+			}
+
+			flushAcks();
+			reapFileWrites(false);
+		}
+
+		// Grab the next frame - frames that arrived together are handed out without another recv()
+		const char *frameData;
+		size_t frameLen = 0;
+		if (!clientSocket.getFrame(frameData, frameLen)) {
+
+			// Read everything there is for now? Otherwise the socket was closed.
+			if (clientSocket.wouldBlock()) {
+				return true;
+			}
+			cout << "Socket was closed...";
+			return false;
+		}
+
+		// Got a frame? We have data
+		if (frameLen > 0 && !handleFrame(frameData, frameLen)) {
+			return false;
+		}
+
+		// Selective ACKs go out as the ACK policy says - each one covers the whole window, so losing some costs nothing
+		if (selectiveAcks && isAckDue()) {
+			sendPendingAck();
+		}
+	}
+}
+
+/**
+ * @brief Handle one frame
+ *
+ * @return bool (false = that was the last packet of the file, or the session was rejected)
+ */
+bool ReceiverSession::handleFrame(const char *frameData, size_t frameLen) {
+
+	// Is this a ping request? We do nothing with it other than sent data back.
+	if (frameLen >= 4 && memcmp(frameData, "PING", 4) == 0) {
+		clientSocket.sendData("PING");
+		return true;
+	}
+
+	// Increase our packet count.
+	numReceived++;
+
+	// Fill a pooled packet from the frame (the data is borrowed from the socket's buffer until we buffer it)
+	PacketPool::Handle dataPacket = packetPool.acquire();
+	dataPacket->reversePacketView(frameData, frameLen);
+	dataPacket->setSeqNumRange(seqNumRange);
+
+	// Track that we received this 'last'
+	lastReceived = dataPacket->showSeqNum();
+
+	// Checksum Status
+	bool validChecksum = dataPacket->isValidChecksum();
+
+	// Did we already process this packet? Everything before curPktNum has been, and the rest of the window is in the buffer.
+	bool isDuplicate = dataPacket->getSeqNum() < curPktNum || packetBuffer.has(dataPacket->getSeqNum());
+	if (isDuplicate) {
+		cout << "Packet " << dataPacket->showSeqNum() << " received (duplicate)\n";
+	} else {
+		// Indicate we received the packet
+		cout << "Packet " << dataPacket->showSeqNum() << " received\n";
+	}
+
+	cout << "Checksum " << (validChecksum ? "OK" : "failed") << "\n";
+
+	// Is this the first packet? Then it sets the stage for creating a file (and the header format our ACK reports)
+	bool isInitialPacket = validChecksum && !isDuplicate && dataPacket->getSeqNum() == 0;
+	if (isInitialPacket) {
+		if (!readInitialPacket(dataPacket->getDataView())) {
+			return false;
+		}
+
+		// Datagram slots only need to fit our packets (or a repeat of this one)
+		clientSocket.setMaxFrameSize(max(frameLen, (size_t) packetSize + Packet::getHeaderSize(headerVersion, integrity)));
+	}
+
+	// Go-Back-N? Only the next packet in order is kept.
+	if (goBackN && curPktNum > 0 && !isInitialPacket) {
+		return handleGoBackN(move(dataPacket), validChecksum);
+	}
+
+	// Beyond the window? The buffer has no slot for it - drop it without an ACK so it's sent again later.
+	if (validChecksum && !isDuplicate && !isInitialPacket && dataPacket->getSeqNum() >= curPktNum + slidingWindowSize) {
+		cout << "Packet " << dataPacket->showSeqNum() << " is outside the window - dropped\n";
+		return true;
+	}
+
+	// Send acknowledgement - with selective ACKs, once the packet is buffered or written (see processFrames())
+	if (selectiveAcks && validChecksum && dataPacket->getSeqNum() > 0) {
+
+		// The first packet the ACK covers starts the delay
+		if (numUnacked == 0) {
+			ackDeadline = chrono::steady_clock::now() + chrono::milliseconds(ackDelayMS);
+		}
+		numUnacked++;
+
+		// Out of order, filling a gap, or a duplicate? ACK it right away (the sender may be missing something).
+		if (isDuplicate || dataPacket->getSeqNum() != curPktNum || packetBuffer.size() > 0) {
+			ackImmediately = true;
+		}
+
+		cumulativeAckPending = true;
+		cumulativeAckHeaderVersion = dataPacket->getHeaderVersion();
+		cumulativeAckIntegrity = dataPacket->getIntegrity();
+	} else {
+		sendAckMessage(dataPacket->getSeqNum(), validChecksum, dataPacket->getHeaderVersion(), dataPacket->getIntegrity());
+		cout << "Ack " << dataPacket->showSeqNum() << " sent\n";
+	}
+
+	// Show the current sliding window
+	showSlidingWindow();
+
+	// If the checksum failed, or it is a duplicate, - no reason to keep the packet.
+	if (!validChecksum || isDuplicate) {
+		return true;
+	}
+
+	// Keep track of the last & highest packet we received.
+	if (dataPacket->getSeqNum() > lastPktNum) {
+		lastPktNum = dataPacket->getSeqNum();
+	}
+
+	// Was this the first packet? We already read the file details above.
+	if (isInitialPacket) {
+		curPktNum++; // Increase the packet number of the next one.
+		return true; // Nothing more to do here.
+	}
+
+	// If the sequence number is next, write it out
+	if (curPktNum == dataPacket->getSeqNum()) { // Next Seq Num
+		writeFileData(move(dataPacket));
+
+		// We can move onto the next packet.
+		curPktNum++;
+	} else {
+		// Add the packet to the buffer - the frame is only valid until the next read, so the packet needs its own copy.
+		long long copiedBefore = Packet::getThreadBytesCopied();
+		dataPacket->ownData();
+		bytesCopied += Packet::getThreadBytesCopied() - copiedBefore;
+		packetBuffer.put(move(dataPacket));
+
+		numBuffered++;
+		maxBuffered = max(maxBuffered, packetBuffer.size());
+	}
+
+	// Process the current buffer of stored packets.
+	processPacketBuffer();
+
+	// Are we done?
+	return curPktNum != numPackets;
+}
+
+/**
+ * @brief Handle a data packet with Go-Back-N
+ *
+ * Anything but the next packet in order is thrown away - the sender goes back and sends it again,
+ * 		along with everything after it. Nothing is buffered, and the ACK is cumulative: it names
+ * 		the last packet received in order.
+ *
+ * @return bool (false = that was the last packet of the file)
+ */
+bool ReceiverSession::handleGoBackN(PacketPool::Handle dataPacket, bool validChecksum) {
+	int seqNum = dataPacket->getSeqNum();
+	int packetHeaderVersion = dataPacket->getHeaderVersion();
+	int packetIntegrity = dataPacket->getIntegrity();
+
+	// Damaged? If it's the one we're waiting for, the sender can go back to it right away.
+	if (!validChecksum) {
+		if (seqNum == curPktNum) {
+			sendAckMessage(seqNum, false, packetHeaderVersion, packetIntegrity);
+			cout << "Ack " << dataPacket->showSeqNum() << " sent\n";
+		}
+		return true;
+	}
+
+	if (seqNum == curPktNum) {
+		lastPktNum = max(lastPktNum, seqNum);
+
+		// Add the data (straight from the packet - no copy)
+		writeFileData(move(dataPacket));
+		curPktNum++;
+	} else if (seqNum > curPktNum) {
+		cout << "Packet " << dataPacket->showSeqNum() << " discarded (out of order)\n";
+	}
+
+	// The cumulative ACK goes out once we've handled everything that's arrived (see flushAcks())
+	cumulativeAckPending = true;
+	cumulativeAckHeaderVersion = packetHeaderVersion;
+	cumulativeAckIntegrity = packetIntegrity;
+
+	// Thrown away? Then a duplicate ACK goes for each one, so the sender can count them and go back
+	// before its timer runs out (fast retransmit).
+	if (seqNum > curPktNum) {
+		sendPendingAck();
+	}
+
+	showSlidingWindow();
+
+	// Are we done?
+	return curPktNum != numPackets;
+}
+
+/**
+ * @brief Wrap up the transfer
+ */
+void ReceiverSession::finish() {
+
+	// Send the final ACKs (a rejected session never started - nothing to ACK)
+	if (!rejected) {
+		sendPendingAck();
+		flushAcks();
+
+		// UDP - stay around to answer retransmissions of packets whose ACKs were lost
+		if (clientSocket.getTransport() == NetSocket::TRANSPORT_UDP) {
+			lingerForSender();
+		}
+	}
+
+	// Close our socket and file (once the writes are done)
+	clientSocket.closeSocket();
+	while (fileIO.getNumInFlight() > 0) {
+		reapFileWrites(true);
+	}
+	if (senderFile >= 0) {
+		close(senderFile);
+	}
+
+	// Math about the number of packets retransmitted
+	int numRetrans = numReceived - numPackets;
+	long long elapsedMS = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTimePoint).count();
+
+	// Statistics!
+	printf("\n\n");
+	printf("Session %d: %s (%s)\n", sessionId, outputFileName.c_str(), (this->isComplete()) ? "complete" : "incomplete");
+	printf("Last packet seq# received: %d\n", lastReceived);
+	printf("Number of original packets received: %d\n", numPackets);
+	printf("Number of retransmitted packets received: %d\n", numRetrans);
+	printf("Session time: %lldms\n", elapsedMS);
+	if (integrity != Packet::INTEGRITY_NONE) {
+		printf("Checksum kernel: %s\n", Checksum::getKernelName((integrity == Packet::INTEGRITY_CRC32C) ? Checksum::getCrcKernel() : Checksum::getKernel()).c_str());
+	}
+	printf("File I/O: %s%s | %lld writes | %lld system calls\n", AsyncIO::getEngineName(fileIO.getEngine()).c_str(),
+		(fileIO.isBufferRegistered()) ? " with registered buffers" : "", fileIO.getNumOperations(), fileIO.getNumSystemCalls());
+	printf("Packet pool: %d packets | %lld acquired | %lld heap allocations\n", packetPool.getCapacity(), packetPool.getNumAcquired(), packetPool.getNumHeapAllocs());
+	printf("ACKs sent: %d (%f per packet received) | %lld send calls | policy: every %d packets or %dms\n", numAcksSent,
+		(numReceived > 0) ? (double) numAcksSent / numReceived : 0.0, clientSocket.getNumSendCalls(), ackEvery, ackDelayMS);
+	printf("Reorder buffer: %d slots | %d packets arrived out of order | %d waiting at most\n", packetBuffer.getCapacity(), numBuffered, maxBuffered);
+	printf("Socket I/O: %s | Packets per syscall: receive %f | send %f\n", clientSocket.getIOName().c_str(),
+		(clientSocket.getNumRecvCalls() > 0) ? (double) clientSocket.getNumFramesReceived() / clientSocket.getNumRecvCalls() : 0.0,
+		(clientSocket.getNumSendCalls() > 0) ? (double) clientSocket.getNumFramesSent() / clientSocket.getNumSendCalls() : 0.0);
+	printf("Bytes copied per data byte: %f\n\n", (fileSize > 0) ? (double) bytesCopied / fileSize : 0.0);
+}
@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include "NetSockets.h"
+#include "Packet.h"
+#include "PacketPool.h"
+#include "PacketWindow.h"
+#include "AsyncIO.h"
+using namespace std;
+#ifndef RECEIVERSESSION_H
+#define RECEIVERSESSION_H
+
+/**
+ * Receiver Session
+ *
+ * Everything the receiver knows about one transfer: its connection, the details from the initial
+ * 		packet, the packets waiting to be written, and the output file.
+ *
+ * A session is only ever used by one thread at a time (the worker that owns its connection).
+ */
+class ReceiverSession {
+
+	private:
+		int sessionId;
+		NetSocket clientSocket;
+
+		PacketPool packetPool;		// Packets (and their data) reused for every frame - sized from the sliding window
+		PacketWindow packetBuffer;	// Out of order packets, by sequence number (with curPktNum, what's a duplicate)
+		Packet ackPacket;			// Reused for every ACK so its data and packet string don't need new memory
+		string outputFileName;		// Name of file being transferred
+		int senderFile = -1; 		// File being saved (written through fileIO)
+		AsyncIO fileIO;				// File writes (io_uring when the kernel has it)
+		vector <PacketPool::Handle> pendingWrites;	// Packets whose data is still being written
+		long long fileWriteOffset = 0;	// Where the next piece of the file goes
+		int curPktNum = 0; 			// Starts at 1 due to special initial packet using 0
+		int lastPktNum = 0;			// Last packet # received - highest (used for sliding)
+		int numPackets = 0;			// Number of packets to expect
+		long long fileSize = 0;		// File size of file being transferred
+		int packetSize = 0;			// Data size of our packets
+		int slidingWindowSize = 0;	// Size of our sliding window
+		int seqNumRange = 0;
+		string protocol = "SR";		// Type of protocol we're using (GBN or SR)
+		bool goBackN = false;		// Go-Back-N: no buffering, cumulative ACKs
+		bool selectiveAcks = false;	// SR with CAP_SACK: cumulative ACKs with a bitmap of the packets buffered
+		bool cumulativeAckPending = false;	// Go-Back-N / selective ACKs: owe the sender an ACK for curPktNum - 1
+		int cumulativeAckHeaderVersion = Packet::HEADER_ASCII;	// Header format and integrity check for that ACK
+		int cumulativeAckIntegrity = Packet::INTEGRITY_CHECKSUM;
+
+		// ACK policy (selective ACKs) - ACK every ackEvery packets or ackDelayMS after the first one not ACK'd, whichever comes first
+		int ackEvery = DEFAULT_ACK_EVERY;
+		int ackDelayMS = DEFAULT_ACK_DELAY_MS;
+		int numUnacked = 0;			// Packets the pending ACK covers that no ACK has yet
+		bool ackImmediately = false;	// Gap or duplicate - the sender should hear about it now
+		chrono::steady_clock::time_point ackDeadline;	// When the pending ACK goes out at the latest
+		int headerVersion = Packet::HEADER_ASCII;	// Header format agreed on in the initial packet
+		int integrity = Packet::INTEGRITY_CHECKSUM;	// Integrity check agreed on in the initial packet
+		uint32_t capabilities = 0;	// Optional features agreed on in the initial packet (SessionSetup::CAP_X)
+		bool rejected = false;		// The initial packet asked for more than a session gets - closed without a transfer
+
+		// Statistics
+		int numReceived = 0;		// How many packets did we receive?
+		int lastReceived = 0;		// What was the last seq number received?
+		int numAcksSent = 0;
+		int numBuffered = 0;		// Packets that arrived out of order
+		int maxBuffered = 0;		// Most packets waiting in the buffer at once
+		long long bytesCopied = 0;	// Packet data this session copied between buffers
+		chrono::steady_clock::time_point startTimePoint;
+
+		bool handleFrame(const char *frameData, size_t frameLen);
+		bool handleGoBackN(PacketPool::Handle dataPacket, bool validChecksum);
+		bool readInitialPacket(DataView rawPacketData);
+		void processPacketBuffer();
+		void sendAckMessage(int seqNum, bool validChecksum, int ackHeaderVersion, int ackIntegrity, bool withBitmap = false);
+		void sendPendingAck();
+		bool isAckDue();
+		void flushAcks();
+		void showSlidingWindow();
+		void writeFileData(PacketPool::Handle packet);
+		void reapFileWrites(bool wait);
+		void lingerForSender();
+
+	public:
+		static const int MAX_PENDING_WRITES = 16;	// File writes in flight before we wait on one
+		static const int UDP_LINGER_MS = 3000;		// How long to keep answering retransmissions after the transfer (UDP)
+		static const int MAX_WINDOW_DISPLAY = 64;	// Bigger windows are shown abbreviated
+		static const int DEFAULT_ACK_EVERY = 1;		// ACK policy defaults - every packet (delayed ACKs off)
+		static const int DEFAULT_ACK_DELAY_MS = 1;
+		static const int MAX_WINDOW_SIZE = 1 << 20;	// Largest window a sender can ask for (packets)
+		static const int MAX_PACKET_SIZE = 16 * 1024 * 1024;	// Largest packet a sender can ask for (bytes)
+		static const long long MAX_SESSION_MEMORY = 1LL << 30;	// Most one session's packet pool and reorder buffer can take (bytes) - the others share the process
+
+		ReceiverSession(int sessionId);
+
+		NetSocket &getSocket();
+		int getSessionId();
+
+		// Delay selective ACKs - one for every ackEvery packets, or ackDelayMS after a packet that has none yet
+		void setAckPolicy(int ackEvery, int ackDelayMS);
+
+		// When the delayed ACK we owe is due (false = none owed) / send it if it is
+		bool getAckDeadline(chrono::steady_clock::time_point &deadline);
+		void sendDelayedAck();
+
+		// Handle every frame available - false once the transfer is over (done or the connection closed)
+		bool processFrames();
+
+		// Send the last ACKs, finish the file, close the connection and show the statistics
+		void finish();
+
+		bool isComplete();
+		long long getFileSize();
+};
+
+#endif
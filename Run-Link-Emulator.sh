@@ -0,0 +1,3 @@
+#!/bin/bash
+clear
+g++ -std=c++11 -o bin/link-emulator link-emulator.cpp && ./bin/link-emulator 32002 127.0.0.1 32001 10 1 100 100
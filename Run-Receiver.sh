@@ -1,4 +1,4 @@
 #!/bin/bash
 clear
 rm out-*
-g++ -std=c++11 -o bin/receiver receiver.cpp NetSockets.cpp Packet.cpp && ./bin/receiver 32001
+g++ -std=c++11 -lpthread -o bin/receiver receiver.cpp ReceiverSession.cpp NetSockets.cpp Packet.cpp PacketPool.cpp PacketWindow.cpp SessionSetup.cpp Checksum.cpp AsyncIO.cpp && ./bin/receiver 32001
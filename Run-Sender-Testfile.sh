@@ -1,3 +1,3 @@
 #!/bin/bash
 clear
-g++ -std=c++11 -lpthread -o bin/sender sender.cpp NetSockets.cpp Packet.cpp && ./bin/sender < ./inputs/sender-input-testfile
+g++ -std=c++11 -lpthread -o bin/sender sender.cpp NetSockets.cpp Packet.cpp PacketPool.cpp SessionSetup.cpp Checksum.cpp AsyncIO.cpp TimerWheel.cpp PacketWindow.cpp RTOEstimator.cpp CongestionControl.cpp Pacer.cpp && ./bin/sender < ./inputs/sender-input-testfile
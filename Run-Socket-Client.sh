@@ -1,3 +1,3 @@
 #!/bin/bash
 clear
-g++ -o bin/socket-client-test socket-client-test.cpp NetSockets.cpp && ./bin/socket-client-test 127.0.0.1 32001
+g++ -std=c++11 -o bin/socket-client-test socket-client-test.cpp NetSockets.cpp AsyncIO.cpp -lpthread && ./bin/socket-client-test 127.0.0.1 32001
@@ -0,0 +1,146 @@
+#include <string>
+#include <cstring>
+#include <arpa/inet.h>
+#include "SessionSetup.h"
+using namespace std;
+
+/**
+ * @brief Add an option with a raw value
+ */
+static void putOption(string &out, int type, const char *value, size_t len) {
+	uint16_t netLen = htons((uint16_t) len);
+
+	out += (char) type;
+	out.append((const char *) &netLen, sizeof(netLen));
+	out.append(value, len);
+}
+
+/**
+ * @brief Add an 8-bit option
+ */
+static void putU8(string &out, int type, int value) {
+	char byte = (char) value;
+	putOption(out, type, &byte, 1);
+}
+
+/**
+ * @brief Add a 32-bit option
+ */
+static void putU32(string &out, int type, uint32_t value) {
+	uint32_t netValue = htonl(value);
+	putOption(out, type, (const char *) &netValue, sizeof(netValue));
+}
+
+/**
+ * @brief Add a 64-bit option (high word first)
+ */
+static void putU64(string &out, int type, uint64_t value) {
+	uint32_t netValue[2] = { htonl((uint32_t) (value >> 32)), htonl((uint32_t) value) };
+	putOption(out, type, (const char *) netValue, sizeof(netValue));
+}
+
+/**
+ * @brief Read an integer option of 1, 4 or 8 bytes
+ */
+static uint64_t getUnsigned(const char *value, size_t len) {
+	if (len == 1) {
+		return (unsigned char) value[0];
+	}
+
+	if (len == 4) {
+		uint32_t netValue;
+		memcpy(&netValue, value, sizeof(netValue));
+		return ntohl(netValue);
+	}
+
+	uint32_t netValue[2];
+	memcpy(netValue, value, sizeof(netValue));
+	return ((uint64_t) ntohl(netValue[0]) << 32) | ntohl(netValue[1]);
+}
+
+/**
+ * @brief Build the option list for the details that are set
+ *
+ * @return string
+ */
+string SessionSetup::encode() {
+	string out;
+	out += (char) SETUP_VERSION;
+
+	if (fileSize >= 0) putU64(out, OPT_FILE_SIZE, fileSize);
+	if (numPackets >= 0) putU64(out, OPT_NUM_PACKETS, numPackets);
+	if (packetSize >= 0) putU32(out, OPT_PACKET_SIZE, packetSize);
+	if (windowSize >= 0) putU32(out, OPT_WINDOW_SIZE, windowSize);
+	if (!protocol.empty()) putOption(out, OPT_PROTOCOL, protocol.data(), protocol.length());
+	if (seqNumRange >= 0) putU32(out, OPT_SEQ_RANGE, seqNumRange);
+	if (!fileName.empty()) putOption(out, OPT_FILE_NAME, fileName.data(), fileName.length());
+	if (headerVersion >= 0) putU8(out, OPT_HEADER_VERSION, headerVersion);
+	if (integrity >= 0) putU8(out, OPT_INTEGRITY, integrity);
+	putU32(out, OPT_CAPABILITIES, capabilities);
+
+	return out;
+}
+
+/**
+ * @brief Read the option list
+ *
+ * Unknown options (and known ones with an unexpected length) are skipped and counted.
+ *
+ * @return bool (false = not a session setup, or the options run past the end)
+ */
+bool SessionSetup::decode(const char *data, size_t len) {
+	numUnknownOptions = 0;
+
+	if (len < 1 || data[0] != (char) SETUP_VERSION) {
+		return false;
+	}
+
+	size_t offset = 1;
+	while (offset < len) {
+
+		// Type + length
+		if (offset + 3 > len) {
+			return false;
+		}
+
+		int type = (unsigned char) data[offset];
+		uint16_t netLen;
+		memcpy(&netLen, data + offset + 1, sizeof(netLen));
+		size_t valueLen = ntohs(netLen);
+		const char *value = data + offset + 3;
+
+		if (offset + 3 + valueLen > len) {
+			return false;
+		}
+		offset += 3 + valueLen;
+
+		// Strings take any length, integers need the size we expect.
+		bool isU8 = (valueLen == 1), isU32 = (valueLen == 4), isU64 = (valueLen == 8);
+
+		if (type == OPT_PROTOCOL) {
+			protocol.assign(value, valueLen);
+		} else if (type == OPT_FILE_NAME) {
+			fileName.assign(value, valueLen);
+		} else if (type == OPT_FILE_SIZE && isU64) {
+			fileSize = getUnsigned(value, valueLen);
+		} else if (type == OPT_NUM_PACKETS && isU64) {
+			numPackets = getUnsigned(value, valueLen);
+		} else if (type == OPT_PACKET_SIZE && isU32) {
+			packetSize = getUnsigned(value, valueLen);
+		} else if (type == OPT_WINDOW_SIZE && isU32) {
+			windowSize = getUnsigned(value, valueLen);
+		} else if (type == OPT_SEQ_RANGE && isU32) {
+			seqNumRange = getUnsigned(value, valueLen);
+		} else if (type == OPT_HEADER_VERSION && isU8) {
+			headerVersion = getUnsigned(value, valueLen);
+		} else if (type == OPT_INTEGRITY && isU8) {
+			integrity = getUnsigned(value, valueLen);
+		} else if (type == OPT_CAPABILITIES && isU32) {
+			capabilities = getUnsigned(value, valueLen);
+		} else {
+			numUnknownOptions++;
+		}
+	}
+
+	return true;
+}
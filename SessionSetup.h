@@ -0,0 +1,59 @@
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+using namespace std;
+#ifndef SESSIONSETUP_H
+#define SESSIONSETUP_H
+
+/**
+ * Session Setup
+ *
+ * The data of the initial packet (seq 0) and of its ACK. It is a version byte followed by
+ * 		type-length-value options:
+ * 			1 byte type | 2 byte length (network order) | value (integers in network order)
+ *
+ * Options we don't know about are skipped, so either side can add new ones without breaking
+ * 		older peers. The sender offers its settings and capabilities; the receiver replies with
+ * 		the header format, integrity check and capabilities it accepted.
+ */
+class SessionSetup {
+
+	public:
+		static const int SETUP_VERSION = 1;
+
+		// Option types
+		static const int OPT_FILE_SIZE = 1;		// 64-bit
+		static const int OPT_NUM_PACKETS = 2;	// 64-bit
+		static const int OPT_PACKET_SIZE = 3;	// 32-bit
+		static const int OPT_WINDOW_SIZE = 4;	// 32-bit
+		static const int OPT_PROTOCOL = 5;		// String (GBN or SR)
+		static const int OPT_SEQ_RANGE = 6;		// 32-bit
+		static const int OPT_FILE_NAME = 7;		// String
+		static const int OPT_HEADER_VERSION = 8;	// 8-bit (Packet::HEADER_X)
+		static const int OPT_INTEGRITY = 9;		// 8-bit (Packet::INTEGRITY_X)
+		static const int OPT_CAPABILITIES = 10;	// 32-bit (CAP_X flags)
+
+		// Capability flags
+		static const uint32_t CAP_COMPRESSION = 1 << 0;	// Reserved - compressed data (not supported yet)
+		static const uint32_t CAP_SACK = 1 << 1;		// Selective ACKs - cumulative point plus a bitmap of what arrived after it (SR)
+
+		// Session details (-1 / empty = not included)
+		long long fileSize = -1;
+		long long numPackets = -1;
+		int packetSize = -1;
+		int windowSize = -1;
+		string protocol;
+		int seqNumRange = -1;
+		string fileName;
+		int headerVersion = -1;
+		int integrity = -1;
+		uint32_t capabilities = 0;
+
+		// Number of options skipped by the last decode()
+		int numUnknownOptions = 0;
+
+		string encode();
+		bool decode(const char *data, size_t len);
+};
+
+#endif
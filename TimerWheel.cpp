@@ -0,0 +1,267 @@
+#include <vector>
+#include <chrono>
+#include "TimerWheel.h"
+using namespace std;
+
+/**
+ * @brief Empty wheel - tick 0 is now
+ */
+TimerWheel::TimerWheel() {
+	this->startTimePoint = chrono::steady_clock::now();
+	this->slotHeads.assign(NUM_LEVELS * NUM_SLOTS, -1);
+}
+
+/**
+ * @brief Tick a time falls on
+ *
+ * @param roundUp Round up to the next tick (deadlines never fire early)
+ */
+uint64_t TimerWheel::getTick(chrono::steady_clock::time_point timePoint, bool roundUp) {
+	long long sinceStartNS = chrono::duration_cast<chrono::nanoseconds>(timePoint - this->startTimePoint).count();
+	long long tickNS = TICK_MS * 1000000LL;
+
+	if (sinceStartNS <= 0) {
+		return 0;
+	}
+	return (roundUp) ? (sinceStartNS + tickNS - 1) / tickNS : sinceStartNS / tickNS;
+}
+
+/**
+ * @brief Put a timer in the slot for its deadline
+ *
+ * The level depends on how far away the deadline is: level 0 if it's within NUM_SLOTS ticks,
+ * 		level 1 within NUM_SLOTS^2 ticks, and so on.
+ */
+void TimerWheel::insert(int timerId) {
+	Timer &timer = this->timers[timerId];
+
+	// Already due? Then it goes off with the next tick.
+	if (timer.expireTick <= this->curTick) {
+		timer.expireTick = this->curTick + 1;
+	}
+
+	// Too far away for the wheel? Cut it short - it will be re-inserted once it comes up.
+	uint64_t delta = timer.expireTick - this->curTick;
+	uint64_t maxDelta = ((uint64_t) 1 << (SLOT_BITS * NUM_LEVELS)) - 1;
+	if (delta > maxDelta) {
+		timer.expireTick = this->curTick + maxDelta;
+		delta = maxDelta;
+	}
+
+	int level = 0;
+	while (level < NUM_LEVELS - 1 && delta >= ((uint64_t) 1 << (SLOT_BITS * (level + 1)))) {
+		level++;
+	}
+
+	int index = (timer.expireTick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1);
+	timer.slot = level * NUM_SLOTS + index;
+
+	// Add to the front of the slot's list
+	timer.prev = -1;
+	timer.next = this->slotHeads[timer.slot];
+	if (timer.next >= 0) {
+		this->timers[timer.next].prev = timerId;
+	}
+	this->slotHeads[timer.slot] = timerId;
+}
+
+/**
+ * @brief Take a timer out of its slot
+ */
+void TimerWheel::unlink(int timerId) {
+	Timer &timer = this->timers[timerId];
+
+	if (timer.prev >= 0) {
+		this->timers[timer.prev].next = timer.next;
+	} else {
+		this->slotHeads[timer.slot] = timer.next;
+	}
+	if (timer.next >= 0) {
+		this->timers[timer.next].prev = timer.prev;
+	}
+
+	timer.slot = -1;
+	timer.prev = -1;
+	timer.next = -1;
+}
+
+/**
+ * @brief Spread a slot's timers over the levels below (its turn has come up)
+ */
+void TimerWheel::cascade(int level, int index) {
+	int slot = level * NUM_SLOTS + index;
+	int timerId = this->slotHeads[slot];
+	this->slotHeads[slot] = -1;
+
+	while (timerId >= 0) {
+		int nextTimerId = this->timers[timerId].next;
+		this->insert(timerId);
+		this->numCascaded++;
+		timerId = nextTimerId;
+	}
+}
+
+/**
+ * @brief Start a timer
+ *
+ * @param deadline When it expires
+ * @param tag Handed back by getExpired()
+ * @return int (timer ID - valid until it expires or is cancelled)
+ */
+int TimerWheel::schedule(chrono::steady_clock::time_point deadline, uint64_t tag) {
+	int timerId;
+	if (!this->freeTimers.empty()) {
+		timerId = this->freeTimers.back();
+		this->freeTimers.pop_back();
+	} else {
+		timerId = this->timers.size();
+		this->timers.push_back(Timer());
+	}
+
+	this->timers[timerId].tag = tag;
+	this->timers[timerId].expireTick = this->getTick(deadline, true);
+	this->insert(timerId);
+	this->numActive++;
+	this->numScheduled++;
+
+	return timerId;
+}
+
+/**
+ * @brief Move a running timer to a new deadline (keeps its ID and tag)
+ */
+void TimerWheel::reschedule(int timerId, chrono::steady_clock::time_point deadline) {
+	if (timerId < 0 || this->timers[timerId].slot < 0) {
+		return;
+	}
+
+	this->unlink(timerId);
+	this->timers[timerId].expireTick = this->getTick(deadline, true);
+	this->insert(timerId);
+	this->numScheduled++;
+}
+
+/**
+ * @brief Stop a timer before it expires
+ */
+void TimerWheel::cancel(int timerId) {
+	if (timerId < 0 || this->timers[timerId].slot < 0) {
+		return;
+	}
+
+	this->unlink(timerId);
+	this->freeTimers.push_back(timerId);
+	this->numActive--;
+	this->numCancelled++;
+}
+
+/**
+ * @brief Move the wheel up to now and collect the timers that expired
+ *
+ * Each tick handles the level 0 slot for that tick. When level 0 wraps, the next level 1 slot
+ * 		is cascaded first (and so on up the levels).
+ *
+ * @param now Current time
+ * @param expired Tags of the expired timers are added here
+ */
+void TimerWheel::getExpired(chrono::steady_clock::time_point now, vector<uint64_t> &expired) {
+	uint64_t nowTick = this->getTick(now, false);
+
+	while (this->curTick < nowTick) {
+
+		// Nothing waiting? Skip straight to now.
+		if (this->numActive == 0) {
+			this->curTick = nowTick;
+			break;
+		}
+
+		this->curTick++;
+
+		// Wrapped? Bring down the timers for the next stretch.
+		for (int level = 1; level < NUM_LEVELS; level++) {
+			int index = (this->curTick >> (SLOT_BITS * (level - 1))) & (NUM_SLOTS - 1);
+			if (index != 0) {
+				break;
+			}
+			this->cascade(level, (this->curTick >> (SLOT_BITS * level)) & (NUM_SLOTS - 1));
+		}
+
+		// Everything in this tick's slot has expired
+		int slot = this->curTick & (NUM_SLOTS - 1);
+		int timerId = this->slotHeads[slot];
+		this->slotHeads[slot] = -1;
+
+		while (timerId >= 0) {
+			Timer &timer = this->timers[timerId];
+			int nextTimerId = timer.next;
+
+			expired.push_back(timer.tag);
+			timer.slot = -1;
+			timer.prev = -1;
+			timer.next = -1;
+			this->freeTimers.push_back(timerId);
+			this->numActive--;
+			this->numExpired++;
+
+			timerId = nextTimerId;
+		}
+	}
+}
+
+/**
+ * @brief When getExpired() next has something to do
+ *
+ * That's the next non-empty level 0 slot, or the next time level 0 wraps (a cascade), whichever
+ * 		comes first - at most NUM_SLOTS slots to look at.
+ *
+ * @param wakeTime Set to the time
+ * @return bool (false = no timers running)
+ */
+bool TimerWheel::getNextWakeTime(chrono::steady_clock::time_point &wakeTime) {
+	if (this->numActive == 0) {
+		return false;
+	}
+
+	uint64_t tick = this->curTick + 1;
+	while ((tick & (NUM_SLOTS - 1)) != 0 && this->slotHeads[tick & (NUM_SLOTS - 1)] < 0) {
+		tick++;
+	}
+
+	wakeTime = this->startTimePoint + chrono::milliseconds(tick * TICK_MS);
+	return true;
+}
+
+/**
+ * @brief Number of timers running
+ */
+int TimerWheel::getNumActive() {
+	return this->numActive;
+}
+
+/**
+ * @brief Number of timers started or moved
+ */
+long long TimerWheel::getNumScheduled() {
+	return this->numScheduled;
+}
+
+/**
+ * @brief Number of timers stopped before they expired
+ */
+long long TimerWheel::getNumCancelled() {
+	return this->numCancelled;
+}
+
+/**
+ * @brief Number of timers that expired
+ */
+long long TimerWheel::getNumExpired() {
+	return this->numExpired;
+}
+
+/**
+ * @brief Number of times a timer was moved down a level
+ */
+long long TimerWheel::getNumCascaded() {
+	return this->numCascaded;
+}
@@ -0,0 +1,78 @@
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+using namespace std;
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+/**
+ * Timer Wheel
+ *
+ * Deadlines for many timers (e.g. one retransmission timeout per packet in flight), in ticks of
+ * 		TICK_MS on the steady clock. Each level is a ring of NUM_SLOTS lists; level 0 holds the
+ * 		timers due within the current NUM_SLOTS ticks, and each level above covers NUM_SLOTS
+ * 		times as much. When a level's ring wraps, the next slot up is spread over the levels below.
+ *
+ * Scheduling and cancelling is O(1), and advancing only touches the timers that expire (plus a
+ * 		cascade now and then) - no matter how many timers are waiting.
+ *
+ * Not thread-safe - use from one thread (or under the caller's lock).
+ */
+class TimerWheel {
+
+	public:
+		static const int TICK_MS = 1;
+		static const int SLOT_BITS = 8;
+		static const int NUM_SLOTS = 1 << SLOT_BITS;
+		static const int NUM_LEVELS = 4;	// Deadlines up to 2^32 ticks away (longer ones are cut short)
+
+	private:
+		struct Timer {
+			uint64_t tag;			// Handed back when the timer expires
+			uint64_t expireTick;
+			int slot = -1;			// Slot it's in (level * NUM_SLOTS + index), -1 = not scheduled
+			int prev = -1, next = -1;	// Neighbours in the slot's list
+		};
+
+		chrono::steady_clock::time_point startTimePoint;	// Tick 0
+		uint64_t curTick = 0;		// Last tick processed
+		vector<Timer> timers;		// Index = timer ID
+		vector<int> freeTimers;
+		vector<int> slotHeads;		// First timer in each slot's list (-1 = empty)
+		int numActive = 0;
+
+		// Statistics
+		long long numScheduled = 0;
+		long long numCancelled = 0;
+		long long numExpired = 0;
+		long long numCascaded = 0;	// Timers moved down a level
+
+		void insert(int timerId);
+		void unlink(int timerId);
+		void cascade(int level, int index);
+		uint64_t getTick(chrono::steady_clock::time_point timePoint, bool roundUp);
+
+	public:
+		TimerWheel();
+
+		// Start a timer (returns its ID) / move it to a new deadline / stop it (ID -1 is ignored)
+		int schedule(chrono::steady_clock::time_point deadline, uint64_t tag);
+		void reschedule(int timerId, chrono::steady_clock::time_point deadline);
+		void cancel(int timerId);
+
+		// Move the wheel up to now, adding the tags of the timers that expired (they are freed)
+		void getExpired(chrono::steady_clock::time_point now, vector<uint64_t> &expired);
+
+		// When getExpired() next has something to do (false = no timers)
+		bool getNextWakeTime(chrono::steady_clock::time_point &wakeTime);
+
+		int getNumActive();
+
+		// Statistics
+		long long getNumScheduled();
+		long long getNumCancelled();
+		long long getNumExpired();
+		long long getNumCascaded();
+};
+
+#endif
@@ -0,0 +1,190 @@
+/**
+ * Checksum Benchmark
+ *
+ * Checks every checksum kernel against a plain per-byte version of the same sum, then times each
+ * 		kernel at the payload sizes used in inputs/ (and a full 1400 byte packet).
+ *
+ * 		RFC 1071 kernels (scalar / SSE2 / AVX2) - must match a byte-at-a-time RFC 1071 sum
+ * 		legacy()                                - must match the original Packet::createChecksum() loop
+ *
+ * Buffers are random, every length from 0 to 1KB (so every odd tail is covered),
+ * 		and start at every offset within a vector (so unaligned loads are too).
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <bitset>
+#include "Checksum.h"
+using namespace std;
+
+// Global Variables
+const int MAX_CHECK_LEN = 1024;			// Longest buffer checked (every length up to this)
+const int MAX_CHECK_OFFSET = 32;		// Start offsets checked (an AVX2 vector)
+const int NUM_RANDOM_CHECKS = 2000;		// Extra checks with random lengths and offsets
+const long long BYTES_PER_RUN = 64LL * 1024 * 1024;	// Bytes summed per timing run
+const unsigned int SEED = 12345;		// Same buffers every run
+
+// Payload sizes from inputs/ (plus a full packet)
+const int PAYLOAD_SIZES[] = { 5, 10, 50, 100, 512, 1400 };
+
+int numMismatches = 0;	// Checks that didn't match
+
+/**
+ * @brief RFC 1071 one byte at a time - big-endian 16-bit words, an odd last byte padded with zero
+ */
+u_short referenceInternet(const char *data, size_t len) {
+	const unsigned char *bytes = (const unsigned char *) data;
+	unsigned long sum = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		sum += (i % 2 == 0) ? bytes[i] << 8 : bytes[i];
+		if (sum & 0xFFFF0000) {
+			sum &= 0xFFFF;
+			sum++;
+		}
+	}
+
+	return (u_short) ~(sum & 0xFFFF);
+}
+
+/**
+ * @brief The original Packet::createChecksum() - each char widened to a 16-bit word
+ */
+u_short referenceLegacy(const char *data, size_t len) {
+	unsigned long sum = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		sum += (unsigned short) bitset<16>(data[i]).to_ulong();
+		if (sum & 0xFFFF0000) {
+			sum &= 0xFFFF;
+			sum++;
+		}
+	}
+
+	return (u_short) ~(sum & 0xFFFF);
+}
+
+/**
+ * @brief Check every kernel (and legacy()) on one buffer
+ */
+void checkBuffer(const char *data, size_t len, const vector<int> &kernels) {
+	u_short expected = referenceInternet(data, len);
+
+	for (int kernel : kernels) {
+		u_short result = Checksum::internet(data, len, kernel);
+		if (result != expected) {
+			if (numMismatches < 10) {
+				printf("MISMATCH: %s kernel | %zu bytes at offset %d | got %04x expected %04x\n", Checksum::getKernelName(kernel).c_str(),
+					len, (int) ((uintptr_t) data % MAX_CHECK_OFFSET), result, expected);
+			}
+			numMismatches++;
+		}
+	}
+
+	u_short legacyExpected = referenceLegacy(data, len);
+	u_short legacyResult = Checksum::legacy(data, len);
+	if (legacyResult != legacyExpected) {
+		if (numMismatches < 10) {
+			printf("MISMATCH: legacy | %zu bytes | got %04x expected %04x\n", len, legacyResult, legacyExpected);
+		}
+		numMismatches++;
+	}
+}
+
+/**
+ * @brief Time one kernel at one payload size
+ *
+ * @param kernel Checksum::KERNEL_X, or -1 for legacy()
+ * @return double (GB/s)
+ */
+double timeKernel(const vector<char> &buffer, int payloadSize, int kernel, double &nsPerPacket) {
+	int numPayloads = buffer.size() / payloadSize;
+	long long numIterations = BYTES_PER_RUN / payloadSize;
+	volatile u_short sink = 0;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (long long i = 0; i < numIterations; i++) {
+		const char *payload = &buffer[(i % numPayloads) * payloadSize];
+		sink = sink + ((kernel < 0) ? Checksum::legacy(payload, payloadSize) : Checksum::internet(payload, payloadSize, kernel));
+	}
+	long long elapsedNS = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+	nsPerPacket = (double) elapsedNS / numIterations;
+	return (double) numIterations * payloadSize / max(1LL, elapsedNS);
+}
+
+int main() {
+	unsigned int seed = SEED;
+
+	// Kernels this CPU can run
+	vector<int> kernels;
+	const int allKernels[] = { Checksum::KERNEL_SCALAR, Checksum::KERNEL_SSE2, Checksum::KERNEL_AVX2 };
+	for (int kernel : allKernels) {
+		if (Checksum::isKernelSupported(kernel)) {
+			kernels.push_back(kernel);
+		} else {
+			printf("%s kernel not supported on this CPU - skipped\n", Checksum::getKernelName(kernel).c_str());
+		}
+	}
+
+	// Random data (bytes >= 0x80 included - the legacy sum treats them differently)
+	vector<char> buffer(4 * 1024 * 1024);
+	for (size_t i = 0; i < buffer.size(); i++) {
+		buffer[i] = (char) rand_r(&seed);
+	}
+
+	// Every length at every offset
+	int numChecks = 0;
+	for (int offset = 0; offset < MAX_CHECK_OFFSET; offset++) {
+		for (int len = 0; len <= MAX_CHECK_LEN; len++) {
+			checkBuffer(&buffer[offset], len, kernels);
+			numChecks++;
+		}
+	}
+
+	// Random lengths anywhere in the buffer (up to a max size datagram)
+	for (int i = 0; i < NUM_RANDOM_CHECKS; i++) {
+		size_t len = rand_r(&seed) % 65508;
+		size_t offset = rand_r(&seed) % (buffer.size() - len);
+		checkBuffer(&buffer[offset], len, kernels);
+		numChecks++;
+	}
+
+	// All 0xFF - the largest sums, so the most carries
+	vector<char> allOnes(65507, (char) 0xFF);
+	for (size_t len = 1; len <= allOnes.size(); len = len * 2 + 1) {
+		checkBuffer(allOnes.data(), len, kernels);
+		numChecks++;
+	}
+
+	printf("Checked %d buffers against the per-byte sums | %d mismatches\n\n", numChecks, numMismatches);
+
+	// Timing
+	printf("%-10s", "Bytes");
+	for (int kernel : kernels) {
+		printf(" | %-22s", Checksum::getKernelName(kernel).c_str());
+	}
+	printf(" | %-22s\n", "Legacy (per byte)");
+
+	for (int payloadSize : PAYLOAD_SIZES) {
+		printf("%-10d", payloadSize);
+
+		for (int kernel : kernels) {
+			double nsPerPacket;
+			double gbPerSecond = timeKernel(buffer, payloadSize, kernel, nsPerPacket);
+			printf(" | %6.2f GB/s %6.1f ns", gbPerSecond, nsPerPacket);
+		}
+
+		double nsPerPacket;
+		double gbPerSecond = timeKernel(buffer, payloadSize, -1, nsPerPacket);
+		printf(" | %6.2f GB/s %6.1f ns\n", gbPerSecond, nsPerPacket);
+	}
+
+	printf("\nBest kernel: %s\n", Checksum::getKernelName(Checksum::getKernel()).c_str());
+	cout << ((numMismatches == 0) ? "PASSED\n" : "FAILED\n");
+
+	return (numMismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/**
+ * Link Emulator
+ *
+ * Sits between a UDP sender and receiver and makes the link between them worse: a one-way
+ * 		delay, random loss, and optionally a bottleneck - a rate limit with a drop-tail queue
+ * 		in front of it, like a router. ACKs coming back are only delayed.
+ *
+ * Point the sender at the emulator's port and the emulator at the receiver. Once the link has
+ * 		been idle for a couple of seconds, it shows what happened to the packets.
+ */
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <queue>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+using namespace std;
+
+// A datagram on its way through the link
+struct Datagram {
+	chrono::steady_clock::time_point deliverTimePoint;
+	long long order;			// Keeps datagrams due at the same time in order
+	bool toReceiver;			// Data (sender -> receiver) or ACK (receiver -> sender)
+	string data;
+};
+
+// Soonest delivery first
+struct LaterDelivery {
+	bool operator()(const Datagram &a, const Datagram &b) {
+		return (a.deliverTimePoint != b.deliverTimePoint) ? a.deliverTimePoint > b.deliverTimePoint : a.order > b.order;
+	}
+};
+
+// Global Variables
+const int MAX_DATAGRAM = 65536;
+const int SOCKET_BUFFER_SIZE = 8 * 1024 * 1024;	// Don't let the kernel drop what the emulator should decide on
+const int IDLE_REPORT_MS = 2000;				// Show the statistics once the link has been idle this long
+const int DEFAULT_QUEUE_PACKETS = 100;
+
+double delayMS;				// One-way delay (both directions)
+double lossPercent;			// Random loss (data only)
+double rateMbps = 0;		// Bottleneck rate (0 = no bottleneck)
+int queuePackets = DEFAULT_QUEUE_PACKETS;	// Packets the bottleneck queue holds
+
+// Statistics (since the last report)
+long long numForwarded = 0;
+long long numRandomDrops = 0;
+long long numQueueDrops = 0;
+long long numAcks = 0;
+int maxQueued = 0;
+
+/**
+ * @brief Show what happened to the packets since the last report
+ */
+void showStats() {
+	long long numData = numForwarded + numRandomDrops + numQueueDrops;
+	printf("Link: %lld data packets | %lld forwarded | %lld random drops | %lld queue drops (%.2f%% lost) | max queue %d | %lld ACKs\n",
+		numData, numForwarded, numRandomDrops, numQueueDrops, (numData > 0) ? (numRandomDrops + numQueueDrops) * 100.0 / numData : 0.0, maxQueued, numAcks);
+	fflush(stdout);
+
+	numForwarded = numRandomDrops = numQueueDrops = numAcks = 0;
+	maxQueued = 0;
+}
+
+/**
+ * @brief UDP socket with big buffers (bound to a port, or any port for 0)
+ *
+ * @return int (file descriptor, -1 = failed)
+ */
+int createSocket(int portNum) {
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	int bufferSize = SOCKET_BUFFER_SIZE;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+	struct sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = INADDR_ANY;
+	address.sin_port = htons(portNum);
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * @brief Main Function for the Link Emulator
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int main(int argc, char *argv[]) {
+
+	// Make sure user provided the ports, the delay and the loss (and optionally the bottleneck)
+	if (argc < 6 || argc > 8) {
+		cout << "Please provide the port to listen on, the receiver's host and port, the one-way delay (ms) and the loss (%),\n"
+			<< "optionally followed by the bottleneck rate (Mbps) and its queue size (packets).\n";
+		cout << "Example: ./link-emulator 9001 127.0.0.1 9000 10 1 100 100\n";
+		return 1;
+	}
+
+	int listenPort, receiverPort;
+	istringstream(argv[1]) >> listenPort;
+	istringstream(argv[3]) >> receiverPort;
+	if (!(istringstream(argv[4]) >> delayMS) || !(istringstream(argv[5]) >> lossPercent) || delayMS < 0 || lossPercent < 0) {
+		cout << "Please provide a valid delay and loss.\n";
+		return 1;
+	}
+	if ((argc >= 7 && !(istringstream(argv[6]) >> rateMbps)) || (argc >= 8 && !(istringstream(argv[7]) >> queuePackets)) || rateMbps < 0 || queuePackets < 1) {
+		cout << "Please provide a valid rate and queue size.\n";
+		return 1;
+	}
+
+	// Where the receiver is
+	struct addrinfo hints = {}, *receiverInfo;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(argv[2], argv[3], &hints, &receiverInfo) != 0) {
+		cout << "Unknown receiver host\n";
+		return 1;
+	}
+	struct sockaddr_in receiverAddress = *(struct sockaddr_in *) receiverInfo->ai_addr;
+	freeaddrinfo(receiverInfo);
+
+	// One socket faces the sender, the other the receiver (it answers whoever sent to it first)
+	int senderFD = createSocket(listenPort);
+	int receiverFD = createSocket(0);
+	if (senderFD < 0 || receiverFD < 0) {
+		cout << "Socket Setup Failed\n";
+		return 1;
+	}
+	struct sockaddr_in senderAddress = {};
+	bool hasSender = false;
+
+	printf("Link: port %d -> %s:%d | delay %.2fms | loss %.2f%% | ", listenPort, argv[2], receiverPort, delayMS, lossPercent);
+	if (rateMbps > 0) {
+		printf("bottleneck %.1f Mbps, %d packet queue\n", rateMbps, queuePackets);
+	} else {
+		printf("no bottleneck\n");
+	}
+	fflush(stdout);
+
+	chrono::nanoseconds delay((long long) (delayMS * 1000000));
+	priority_queue<Datagram, vector<Datagram>, LaterDelivery> inFlight;
+	deque<chrono::steady_clock::time_point> queueDepartures;	// When each packet in the bottleneck queue leaves it
+	chrono::steady_clock::time_point linkFreeTimePoint = chrono::steady_clock::now();	// When the bottleneck finishes what's queued
+	chrono::steady_clock::time_point lastActivityTimePoint = chrono::steady_clock::now();
+	bool hasActivity = false;
+	long long nextOrder = 0;
+	vector<char> buffer(MAX_DATAGRAM);
+
+	// Pass datagrams through FOR-EV-ER
+	while (1) {
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+		// Sleep until a datagram arrives or the next one is due
+		long long waitNS = IDLE_REPORT_MS * 1000000LL;
+		if (!inFlight.empty()) {
+			waitNS = max(0LL, (long long) chrono::duration_cast<chrono::nanoseconds>(inFlight.top().deliverTimePoint - now).count());
+		}
+		struct timespec timeout = { (time_t) (waitNS / 1000000000), (long) (waitNS % 1000000000) };
+		struct pollfd fds[2] = { { senderFD, POLLIN, 0 }, { receiverFD, POLLIN, 0 } };
+		if (ppoll(fds, 2, &timeout, nullptr) < 0 && errno != EINTR) {
+			cout << "Poll Failed\n";
+			return 1;
+		}
+		now = chrono::steady_clock::now();
+
+		// Data from the sender - lose it, queue it at the bottleneck, or just delay it
+		while (1) {
+			struct sockaddr_in fromAddress;
+			socklen_t fromLen = sizeof(fromAddress);
+			ssize_t len = recvfrom(senderFD, buffer.data(), buffer.size(), MSG_DONTWAIT, (struct sockaddr *)&fromAddress, &fromLen);
+			if (len < 0) {
+				break;
+			}
+			senderAddress = fromAddress;
+			hasSender = true;
+			hasActivity = true;
+			lastActivityTimePoint = now;
+
+			if (rand() < lossPercent / 100 * RAND_MAX) {
+				numRandomDrops++;
+				continue;
+			}
+
+			Datagram datagram;
+			datagram.order = nextOrder++;
+			datagram.toReceiver = true;
+			datagram.data.assign(buffer.data(), len);
+			datagram.deliverTimePoint = now + delay;
+
+			// Bottleneck - wait behind what's queued, or get dropped if the queue is full
+			if (rateMbps > 0) {
+				while (!queueDepartures.empty() && queueDepartures.front() <= now) {
+					queueDepartures.pop_front();
+				}
+				if ((int) queueDepartures.size() >= queuePackets) {
+					numQueueDrops++;
+					continue;
+				}
+
+				chrono::nanoseconds sendTime((long long) (len * 8 * 1000.0 / rateMbps));
+				linkFreeTimePoint = max(linkFreeTimePoint, now) + sendTime;
+				queueDepartures.push_back(linkFreeTimePoint);
+				maxQueued = max(maxQueued, (int) queueDepartures.size());
+				datagram.deliverTimePoint = linkFreeTimePoint + delay;
+			}
+
+			inFlight.push(datagram);
+			numForwarded++;
+		}
+
+		// ACKs from the receiver - just delayed
+		while (1) {
+			ssize_t len = recv(receiverFD, buffer.data(), buffer.size(), MSG_DONTWAIT);
+			if (len < 0) {
+				break;
+			}
+			lastActivityTimePoint = now;
+
+			Datagram datagram;
+			datagram.order = nextOrder++;
+			datagram.toReceiver = false;
+			datagram.data.assign(buffer.data(), len);
+			datagram.deliverTimePoint = now + delay;
+			inFlight.push(datagram);
+			numAcks++;
+		}
+
+		// Deliver everything that's due
+		now = chrono::steady_clock::now();
+		while (!inFlight.empty() && inFlight.top().deliverTimePoint <= now) {
+			const Datagram &datagram = inFlight.top();
+			if (datagram.toReceiver) {
+				sendto(receiverFD, datagram.data.data(), datagram.data.length(), 0, (struct sockaddr *)&receiverAddress, sizeof(receiverAddress));
+			} else if (hasSender) {
+				sendto(senderFD, datagram.data.data(), datagram.data.length(), 0, (struct sockaddr *)&senderAddress, sizeof(senderAddress));
+			}
+			inFlight.pop();
+		}
+
+		// Quiet for a while? The transfer's over - show how it went.
+		if (hasActivity && inFlight.empty() && now - lastActivityTimePoint > chrono::milliseconds(IDLE_REPORT_MS)) {
+			showStats();
+			hasActivity = false;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * Packet Benchmark
+ *
+ * Round-trips packets through both header formats, then times the encode and decode paths.
+ *
+ * 		Round trip - writePacketString() then reversePacketView() into a fresh packet: the header
+ * 					 version, integrity, sequence number, ack and data must all come back, the
+ * 					 checksum must validate, and a forced NACK must not.
+ * 		Encode     - writePacketString() into a reused string (what getFrame() does on a miss)
+ * 		Decode     - reversePacketView() + isValidChecksum() (what the receiver does per frame)
+ * 		Junk       - frames that aren't packets must fail the checksum (not throw)
+ *
+ * Goodput is the payload's share of the bytes on the wire, and the payload rate through an
+ * 		encode + decode.
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Packet.h"
+using namespace std;
+
+// Global Variables
+const int MAX_CHECK_LEN = 1500;		// Round trips at every data length up to this
+const int NUM_ITERATIONS = 200000;	// Packets encoded / decoded per timing run
+const unsigned int SEED = 12345;	// Same packets every run
+
+// Payload sizes timed (ACK sized, a small packet, a full packet)
+const int PAYLOAD_SIZES[] = { 10, 512, 1400 };
+
+int numFailures = 0;	// Round trips that didn't come back the same
+
+// A header format to test (binary with each integrity algorithm)
+struct Format {
+	const char *name;
+	int headerVersion;
+	int integrity;
+};
+
+const Format FORMATS[] = {
+	{ "ASCII", Packet::HEADER_ASCII, Packet::INTEGRITY_CHECKSUM },
+	{ "Binary", Packet::HEADER_BINARY, Packet::INTEGRITY_CHECKSUM },
+	{ "Binary CRC32C", Packet::HEADER_BINARY, Packet::INTEGRITY_CRC32C },
+	{ "Binary none", Packet::HEADER_BINARY, Packet::INTEGRITY_NONE },
+};
+
+/**
+ * @brief Report a round trip that went wrong
+ */
+void fail(const Format &format, size_t len, const char *what) {
+	if (numFailures < 10) {
+		printf("FAILED: %s | %zu bytes | %s\n", format.name, len, what);
+	}
+	numFailures++;
+}
+
+/**
+ * @brief Fill a packet with a random sequence number, ack and data
+ */
+void fillPacket(Packet &packet, const Format &format, size_t len, unsigned int &seed) {
+	packet.setHeaderVersion(format.headerVersion);
+	packet.setIntegrity(format.integrity);
+	packet.setSeqNum(rand_r(&seed) & 0x7FFFFFFF);
+	packet.setAck(rand_r(&seed) % 3);
+
+	char *data = packet.prepareData(len);
+	for (size_t i = 0; i < len; i++) {
+		data[i] = (char) rand_r(&seed);
+	}
+}
+
+/**
+ * @brief Encode a packet, decode it into a fresh one and compare
+ */
+void checkRoundTrip(const Format &format, size_t len, unsigned int &seed) {
+	Packet original;
+	fillPacket(original, format, len, seed);
+
+	string frame;
+	original.writePacketString(frame, false);
+
+	if (frame.length() != Packet::getHeaderSize(format.headerVersion, format.integrity) + len) {
+		fail(format, len, "wrong frame length");
+		return;
+	}
+
+	Packet decoded;
+	decoded.reversePacketView(frame.data(), frame.length());
+
+	if (decoded.getHeaderVersion() != format.headerVersion) fail(format, len, "header version");
+	if (decoded.getIntegrity() != format.integrity) fail(format, len, "integrity algorithm");
+	if (decoded.getSeqNum() != original.getSeqNum()) fail(format, len, "sequence number");
+	if (decoded.getAck() != original.getAck()) fail(format, len, "ack");
+	if (decoded.getDataSize() != len || memcmp(decoded.getDataPtr(), original.getDataPtr(), len) != 0) fail(format, len, "data");
+	if (!decoded.isValidChecksum()) fail(format, len, "checksum didn't validate");
+
+	// A forced NACK has to fail the check (there's nothing to fail without one)
+	if (format.integrity != Packet::INTEGRITY_NONE) {
+		string nackFrame;
+		original.writePacketString(nackFrame, true);
+
+		Packet nack;
+		nack.reversePacketView(nackFrame.data(), nackFrame.length());
+		if (nack.isValidChecksum() && original.createIntegrityValue() != 0) {
+			fail(format, len, "forced NACK validated");
+		}
+	}
+}
+
+int main() {
+	unsigned int seed = SEED;
+
+	// Round trips - every length (odd and even) in every format
+	int numChecks = 0;
+	for (const Format &format : FORMATS) {
+		for (int len = 0; len <= MAX_CHECK_LEN; len++) {
+			checkRoundTrip(format, len, seed);
+			numChecks++;
+		}
+	}
+
+	// Junk (anything can connect) - must decode as a failed checksum, not throw
+	const Format &ascii = FORMATS[0];
+	for (int len = 0; len <= 2 * Packet::HEADER_ASCII_SIZE; len++) {
+		string junk(len, '0');
+		for (int i = 0; i < len; i++) {
+			junk[i] = (rand_r(&seed) % 4 == 0) ? (char) rand_r(&seed) : (char) ('0' + rand_r(&seed) % 2);
+		}
+		if (len > 0 && junk[0] == (char) Packet::HEADER_BINARY) {
+			junk[0] = 'x';
+		}
+		if (len > Packet::HEADER_ASCII_SIZE / 2) {
+			junk[Packet::HEADER_ASCII_SIZE / 2] = 'x';
+		}
+
+		Packet decoded;
+		decoded.reversePacketView(junk.data(), junk.length());
+		if (decoded.isValidChecksum()) fail(ascii, len, "junk header validated");
+		numChecks++;
+	}
+
+	printf("Round-tripped %d packets | %d failures\n\n", numChecks, numFailures);
+
+	// Timing
+	printf("%-14s %-6s | %-6s %-10s %-8s | %-12s %-12s | %s\n", "Format", "Bytes", "Header", "Wire bytes", "Goodput", "Encode", "Decode", "Payload rate");
+
+	for (int payloadSize : PAYLOAD_SIZES) {
+		for (const Format &format : FORMATS) {
+			Packet packet;
+			fillPacket(packet, format, payloadSize, seed);
+
+			// Encode - the same string every time, like the frame cache
+			string frame;
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (int i = 0; i < NUM_ITERATIONS; i++) {
+				packet.setSeqNum(i);
+				packet.writePacketString(frame, false);
+			}
+			long long encodeNS = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+			// Decode - parse and check, data borrowed from the frame
+			Packet decoded;
+			int numValid = 0;
+			start = chrono::steady_clock::now();
+			for (int i = 0; i < NUM_ITERATIONS; i++) {
+				decoded.reversePacketView(frame.data(), frame.length());
+				numValid += decoded.isValidChecksum();
+			}
+			long long decodeNS = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+			if (numValid != NUM_ITERATIONS) {
+				fail(format, payloadSize, "timed packet didn't validate");
+			}
+
+			int headerSize = Packet::getHeaderSize(format.headerVersion, format.integrity);
+			double encodePerPacket = (double) encodeNS / NUM_ITERATIONS;
+			double decodePerPacket = (double) decodeNS / NUM_ITERATIONS;
+			printf("%-14s %-6d | %-6d %-10d %-8.3f | %7.1f ns   %7.1f ns   | %.2f Gbps\n", format.name, payloadSize, headerSize,
+				headerSize + payloadSize, (double) payloadSize / (headerSize + payloadSize), encodePerPacket, decodePerPacket,
+				payloadSize * 8.0 / (encodePerPacket + decodePerPacket));
+		}
+	}
+
+	cout << ((numFailures == 0) ? "\nPASSED\n" : "\nFAILED\n");
+
+	return (numFailures == 0) ? 0 : 1;
+}
@@ -1,190 +1,252 @@
 /**
  * Receiver
- * 
- * This program listens for a connection and receives a file.
+ *
+ * This program listens for connections and receives files - many senders at once with TCP.
+ *
+ * The main thread accepts connections and hands each one (as a ReceiverSession) to a worker thread.
+ * 		Every worker waits on its connections with epoll and handles whichever have data.
  */
 #include <memory>
 #include <map>
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <vector>
-#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include "NetSockets.h"
-#include "Packet.h"
+#include "ReceiverSession.h"
 using namespace std;
- 
-// Global Variables
-string dataString;
-vector <unique_ptr <Packet> > packetBuffer;
-string outputFileName;		// Name of file being transferred
-ofstream senderFile; 	// Pointer to file being saved
-int curPktNum = 0; 		// Starts at 1 due to special initial packet using 0
-int lastPktNum = 0;		// Last packet # received - highest (used for sliding)
-int numPackets = 0;		// Number of packets to expect
-int fileSize = 0;		// File size of file being transferred
-int packetSize = 0;		// Data size of our packets	
-int slidingWindowSize = 0; // Size of our sliding window
-int seqNumRange = 0;
-map<int, bool> donePackets;	// List of packets already processed (for duplicate detection)
-string protocol = "SR";		// Type of protocol we're using (GBN or SR)
 
+// A worker thread and the sessions it owns
+struct Worker {
+	int epollFD = -1;		// Waits on the worker's connections (and wakeFD)
+	int wakeFD = -1;		// Written to when new sessions are handed over
+	mutex newSessionsLock;
+	vector<unique_ptr<ReceiverSession>> newSessions;	// Handed over, not picked up yet
+	map<int, unique_ptr<ReceiverSession>> sessions;		// By file descriptor
+	thread workerThread;
+};
+
+// Global Variables
+const int MAX_EVENTS = 64;				// Events handled per epoll_wait()
+const int DEFAULT_NUM_WORKERS = 1;
+const int DEFAULT_MAX_CONNECTIONS = 64;
+vector<unique_ptr<Worker>> workers;
+int ackEvery = ReceiverSession::DEFAULT_ACK_EVERY;		// ACK policy for every session (see ReceiverSession::setAckPolicy())
+int ackDelayMS = ReceiverSession::DEFAULT_ACK_DELAY_MS;
+
+// Statistics (shared by the workers)
+mutex statsLock;
+int numActiveSessions = 0;			// Sessions accepted and not finished yet
+int numBusyTransfers = 0;			// Transfers finished since the receiver was last idle
+long long numBusyBytes = 0;			// Bytes of those transfers
+chrono::steady_clock::time_point busyStartTimePoint;	// When the receiver was last idle
+double busyStartCPUSeconds = 0;		// CPU time used by then
+long long busyStartBytesCopied = 0;	// Packet data copied by then (every session)
 
 /**
- * @brief Read the initial packet
- * 
+ * @brief CPU time used by the receiver so far (every thread)
  */
-void readInitialPacket(vector <char> rawPacketData) {
-
-	// Convert the data to a string
-	string packetData = rawPacketData.data();
-
-	// First 16 bytes are filesize
-	fileSize = stoi(packetData.substr(0, 16));
-
-	// Second 16 bytes are number of packets
-	numPackets = stoi(packetData.substr(16, 16));
+double getCPUSeconds() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
 
-	// Third 16 bytes are the packet size
-	packetSize = stoi(packetData.substr(32, 16));
+/**
+ * @brief Most memory the receiver has had resident so far (KB)
+ */
+long getPeakMemoryKB() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
 
-	// Fourth 16 bytes are window size
-	slidingWindowSize = stoi(packetData.substr(48, 16));
+/**
+ * @brief A session was accepted
+ *
+ * @return bool (false = we're at the connection limit)
+ */
+bool startSession(int maxConnections) {
+	lock_guard<mutex> lock(statsLock);
 
-	// Fifth 3 bytes are protocol
-	protocol = packetData.substr(64, 3);
+	if (numActiveSessions >= maxConnections) {
+		return false;
+	}
 
-	// Sixth 16 bytes are sequence number range
-	seqNumRange = stoi(packetData.substr(67, 16));
+	// First one since we were idle? The aggregate numbers start here.
+	if (numActiveSessions == 0) {
+		busyStartTimePoint = chrono::steady_clock::now();
+		busyStartCPUSeconds = getCPUSeconds();
+		busyStartBytesCopied = Packet::getBytesCopied();
+		numBusyTransfers = 0;
+		numBusyBytes = 0;
+	}
+	numActiveSessions++;
 
-	// Everything else is file name.
-	outputFileName = packetData.substr(83);
+	return true;
+}
 
-	// Open up the file for writing
-	senderFile.open(outputFileName, ios::out | ios::binary);
+/**
+ * @brief A session finished
+ *
+ * Once every session is done, show the aggregate throughput since the receiver was last idle.
+ */
+void endSession(ReceiverSession &session) {
+	lock_guard<mutex> lock(statsLock);
 
-	// TODO: Check for existence
-	cout << "File Details: " << outputFileName << " | Size: " << to_string(fileSize) << "\n"
-		<< "# Packets: " << to_string(numPackets) << " | Packet Size: " << to_string(packetSize) 
-		<< " | Window Size: " << to_string(slidingWindowSize) << " | Protocol: " << protocol << "\n";
+	if (session.isComplete()) {
+		numBusyTransfers++;
+		numBusyBytes += session.getFileSize();
+	}
+	numActiveSessions--;
+
+	if (numActiveSessions == 0) {
+		long long elapsedMS = max(1LL, (long long) chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - busyStartTimePoint).count());
+		double cpuSeconds = getCPUSeconds() - busyStartCPUSeconds;
+		long long bytesCopied = Packet::getBytesCopied() - busyStartBytesCopied;
+		printf("Aggregate: %d transfers | %lld bytes | %lldms | %f Mbps | %.3f CPU-seconds (%.2f per GB) | %f bytes copied per data byte | peak memory %ld KB\n\n",
+			numBusyTransfers, numBusyBytes, elapsedMS, (numBusyBytes * 8.0 / 1000000) / (elapsedMS / 1000.0), cpuSeconds,
+			(numBusyBytes > 0) ? cpuSeconds / (numBusyBytes / 1000000000.0) : 0.0, (numBusyBytes > 0) ? (double) bytesCopied / numBusyBytes : 0.0, getPeakMemoryKB());
+		fflush(stdout);
+	}
 }
 
 /**
- * @brief Compare two packets to sort them by sequence number
+ * @brief How long a worker can wait before one of its sessions owes a delayed ACK
+ *
+ * @return int (ms, -1 = no delayed ACKs owed)
  */
-bool comparePacketSeq(unique_ptr<Packet>& pkt1, unique_ptr<Packet>& pkt2) {
-	return (pkt1->getSeqNum() < pkt2->getSeqNum());
+int getAckTimeout(Worker *worker) {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	long long timeoutMS = -1;
+
+	for (map<int, unique_ptr<ReceiverSession>>::iterator iterator = worker->sessions.begin(); iterator != worker->sessions.end(); ++iterator) {
+		chrono::steady_clock::time_point deadline;
+		if (iterator->second->getAckDeadline(deadline)) {
+			long long untilMS = max(0LL, (long long) chrono::duration_cast<chrono::milliseconds>(deadline - now).count() + 1);
+			timeoutMS = (timeoutMS < 0) ? untilMS : min(timeoutMS, untilMS);
+		}
+	}
+
+	return (int) timeoutMS;
 }
 
 /**
- * @brief Process the packet buffer
- * 
- * After every packet is received, which precedes this function, we want to go through the
- * 		buffer of stored packets to reconstruct the file. This method works by comparing 
- * 		the packet we *should* be on with the ones stored in the buffer. If we're ready to move
- * 		forward, it'll write to the file and see if we should move onto the next packet in the buffer
- * 
- * All data in the buffer is sorted already after we receive a packet out of order.
+ * @brief Worker thread - handles every frame that arrives for its sessions
  */
-void processPacketBuffer() {
-	// Loop through the packetBuffer to see if we can move it forward
-	vector<unique_ptr<Packet>>::iterator iterator = packetBuffer.begin();
-	while (iterator != packetBuffer.end()) {
-
-		// If the sequence number is greater than the packet we are working with, it's not ready yet. Stop and wait for next packet
-		if ((*iterator)->getSeqNum() > curPktNum) {
-			++iterator;
-			break;
+void runWorker(Worker *worker) {
+	struct epoll_event events[MAX_EVENTS];
+
+	while (1) {
+		// Sleep until a connection has data (or a delayed ACK is due)
+		int numEvents = epoll_wait(worker->epollFD, events, MAX_EVENTS, getAckTimeout(worker));
+		if (numEvents < 0) {
+			if (errno == EINTR) continue;
+			cout << "epoll_wait Failed\n";
+			return;
 		}
 
-		// Add the data
-		vector <char> fileData = (*iterator)->getData();
-		// dataString += fileData;
+		for (int i = 0; i < numEvents; i++) {
+			int fd = events[i].data.fd;
+
+			// New sessions? Start watching their connections.
+			if (fd == worker->wakeFD) {
+				uint64_t count;
+				if (read(worker->wakeFD, &count, sizeof(count)) < 0) {
+					// Nothing to do - another read got there first
+				}
 
-		senderFile.write(fileData.data(), fileData.size());
-		senderFile.flush(); // Immediately write to the file
+				lock_guard<mutex> lock(worker->newSessionsLock);
+				for (size_t j = 0; j < worker->newSessions.size(); j++) {
+					int sessionFD = worker->newSessions[j]->getSocket().getFileDescriptor();
 
-		// We can move onto the next packet.
-		curPktNum++;
+					struct epoll_event event = {};
+					event.events = EPOLLIN;
+					event.data.fd = sessionFD;
+					epoll_ctl(worker->epollFD, EPOLL_CTL_ADD, sessionFD, &event);
+
+					worker->sessions[sessionFD] = move(worker->newSessions[j]);
+				}
+				worker->newSessions.clear();
+				continue;
+			}
 
-		// Remove the element from the list.
-		iterator = packetBuffer.erase(iterator);
+			map<int, unique_ptr<ReceiverSession>>::iterator found = worker->sessions.find(fd);
+			if (found == worker->sessions.end()) {
+				continue;
+			}
+
+			// Handle everything that's arrived - still going? Then wait for more.
+			if (found->second->processFrames()) {
+				continue;
+			}
+
+			// The transfer is over
+			epoll_ctl(worker->epollFD, EPOLL_CTL_DEL, fd, nullptr);
+			found->second->finish();
+			endSession(*found->second);
+			worker->sessions.erase(found);
+		}
+
+		// Send the delayed ACKs that are due
+		for (map<int, unique_ptr<ReceiverSession>>::iterator iterator = worker->sessions.begin(); iterator != worker->sessions.end(); ++iterator) {
+			iterator->second->sendDelayedAck();
+		}
 	}
 }
 
 /**
- * @brief Send back an ACK packet 
- * 
- * This sends a packet back to the client connection.
- * 
- * @param seqNum 		Sequence number of the packet
- * @param validChecksum Checksum status (true = valid, false = invalid)
+ * @brief Hand a session to a worker
  */
-void sendAckMessage(NetSocket *clientSocket, int seqNum, bool validChecksum) {
-
-	// Build the packet (no data needed, just sequence # and ack state)
-	Packet ackPacket = Packet();
-	ackPacket.setSeqNum(seqNum);
-	ackPacket.setSeqNumRange(seqNumRange);
-	ackPacket.setAck((validChecksum) ? Packet::ACK_OK : Packet::ACK_FAIL);
-	ackPacket.setData(vector <char> (1));
+void handOver(Worker *worker, unique_ptr<ReceiverSession> session) {
+	{
+		lock_guard<mutex> lock(worker->newSessionsLock);
+		worker->newSessions.push_back(move(session));
+	}
 
-	// Send the request back
-	clientSocket->sendData(ackPacket.createPacketString());
+	uint64_t count = 1;
+	if (write(worker->wakeFD, &count, sizeof(count)) < 0) {
+		cout << "Wake Failed\n";
+	}
 }
 
 /**
- * @brief Show the sliding window on the receiver side
- * 
- * The windows shifts after each ACK.
- * Selective Repeat = Size = N | Go-Back-N = 1
- * Example: [1, 2, 3, 4, 5]
+ * @brief Read a positive number from the arguments
+ *
+ * @return bool (false = not a positive number)
  */
-void showSlidingWindow() {
-
-	int slidingWindowFront = curPktNum + 1; // Our sliding number is based on *after* ACK is sent.
-
-    // Create the window display
-    int slidingWindowMax = slidingWindowFront + slidingWindowSize - 1;
-    string windowDisplay = "Current window = [";
-    for (int i = slidingWindowFront; i <= slidingWindowMax; i++) {
-
-        // Display the number (how depends on range)
-        if (seqNumRange > 0) {
-            windowDisplay.append(to_string(i % seqNumRange));
-        } else {
-            windowDisplay.append(to_string(i));
-        }
-
-        if (i != slidingWindowMax) {
-            windowDisplay.append(", ");
-        }
-    }
-    windowDisplay.append("]");
-
-    // Display the full window - we do this at the end to prevent delays in cout.
-    printf("%s\n", windowDisplay.c_str());
+bool readPositiveArg(const char *arg, int &value) {
+	istringstream iss(arg);
+	return (iss >> value) && value > 0;
 }
 
 /**
  * @brief Main Function for Receiver
- * 
- * @param argc 
- * @param argv 
- * @return int 
+ *
+ * @param argc
+ * @param argv
+ * @return int
  */
 int main(int argc, char *argv[]) {
 
 	// Global Variables
 	int portNum;
-	int numReceived = 0; // How many packets did we receive?
-	int numRetrans = 0; // How many packets re-transmitted?
-	int lastReceived = 0; // What was the last seq number received?
-
-	// Make sure user provided a port
-	if (argc != 2) {
-		cout << "Please provide a port # above 1024 as a parameter.\n";
-		cout << "Example: ./receiver 10000\n";
+	int numWorkers = DEFAULT_NUM_WORKERS;
+	int maxConnections = DEFAULT_MAX_CONNECTIONS;
+
+	// Make sure user provided a port (and optionally the transport, worker threads, connection limit and ACK policy)
+	if (argc < 2 || argc > 7) {
+		cout << "Please provide a port # above 1024 as a parameter, optionally followed by TCP or UDP, the # of worker threads, the max # of connections,\n"
+			<< "and how many packets / milliseconds an ACK can wait for (selective ACKs).\n";
+		cout << "Example: ./receiver 10000 TCP 4 64 8 2\n";
 		return 1;
 	}
 
@@ -203,118 +265,97 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	// Create the socket and listen
-	NetSocket clientSocket;
-	clientSocket.createServerSocket(portNum);
-
-	// Keep reading FOR-EV-ER  (until we say stop / socket is closed)
-	while (1) {
-		string socketData = clientSocket.getFromSocket(packetSize);
-
-		// Length greater than 0? We have data
-		if (socketData.length() > 0) {
-
-			// Is this a ping request? We do nothing with it other than sent data back.
-			if (socketData.substr(0, 4) == "PING") {
-				clientSocket.sendData("PING");
-				continue;
-			}
-
-			// Increase our packet count.
-			numReceived++;
-
-			// Create a new packet from the socket data
-			unique_ptr<Packet> dataPacket(new Packet());
-			dataPacket->reversePacket(socketData);
-			dataPacket->setSeqNumRange(seqNumRange);
-
-			// Track that we received this 'last'
-			lastReceived = dataPacket->showSeqNum();
-
-			// Checksum Status
-			bool validChecksum = dataPacket->isValidChecksum();
-
-			// Did we already process this packet?
-			bool isDuplicate = donePackets.find(dataPacket->getSeqNum()) != donePackets.end();
-			if (isDuplicate) {
-				cout << "Packet " << dataPacket->showSeqNum() << " received (duplicate)\n";
-			} else {
-				// Indicate we received the packet
-				cout << "Packet " << dataPacket->showSeqNum() << " received\n";
-			}
-
-			cout << "Checksum " << (validChecksum ? "OK" : "failed") << "\n";
-
-			// Send acknowledgement
-			sendAckMessage(&clientSocket, dataPacket->getSeqNum(), validChecksum);
-			cout << "Ack " << dataPacket->showSeqNum() << " sent\n";
+	// Which transport? (must match the sender)
+	string transportType = (argc >= 3) ? argv[2] : "TCP";
+	if (transportType != "TCP" && transportType != "UDP") {
+		cout << "Please enter TCP or UDP as the transport.\n";
+		return 1;
+	}
 
-			// Show the current sliding window
-			showSlidingWindow();
+	if (argc >= 4 && !readPositiveArg(argv[3], numWorkers)) {
+		cout << "Please provide a valid # of worker threads.\n";
+		return 1;
+	}
 
-			// If the checksum failed, or it is a duplicate, - no reason to keep the packet.
-			if (!validChecksum || isDuplicate) {
-				continue;
-			}
+	if (argc >= 5 && !readPositiveArg(argv[4], maxConnections)) {
+		cout << "Please provide a valid max # of connections.\n";
+		return 1;
+	}
 
-			// Indicate the packet was processed
-			donePackets[dataPacket->getSeqNum()] = 1;
+	if (argc >= 6 && !readPositiveArg(argv[5], ackEvery)) {
+		cout << "Please provide a valid # of packets per ACK.\n";
+		return 1;
+	}
 
-			// Keep track of the last & highest packet we received.
-			if (dataPacket->getSeqNum() > lastPktNum) {
-				lastPktNum = dataPacket->getSeqNum();
-			}
+	if (argc >= 7 && !readPositiveArg(argv[6], ackDelayMS)) {
+		cout << "Please provide a valid ACK delay (ms).\n";
+		return 1;
+	}
 
-			// Is this the first packet? Then it sets the stage for creating a file
-			if (dataPacket->getSeqNum() == 0) {
-				readInitialPacket(dataPacket->getData());
-				curPktNum++; // Increase the packet number of the next one.
-				continue; // Nothing more to do here.
-			}
+	// UDP - there are no connections to accept, so it's one sender per receiver.
+	if (transportType == "UDP") {
+		ReceiverSession session(1);
+		session.setAckPolicy(ackEvery, ackDelayMS);
+		session.getSocket().setTransport(NetSocket::TRANSPORT_UDP);
+		if (!session.getSocket().createServerSocket(portNum)) {
+			return 1;
+		}
+		session.getSocket().useAsyncIO();
 
-			// If the sequence number is next, add it to the beginning of the list
-			if (curPktNum == dataPacket->getSeqNum()) { // Next Seq Num
-				packetBuffer.insert(packetBuffer.begin(), move(dataPacket));
-			} else {
-				// Add the packet to the buffer
-				packetBuffer.push_back(move(dataPacket));
+		// Keep reading FOR-EV-ER  (until we say stop / socket is closed)
+		while (session.processFrames()) {
+		}
+		session.finish();
 
-				// Sort the buffer for easier processing
-				sort(packetBuffer.begin(), packetBuffer.end(), comparePacketSeq);
-			}
+		return 0;
+	}
 
-			// Process the current buffer of stored packets.
-			processPacketBuffer();
+	// Start the workers
+	for (int i = 0; i < numWorkers; i++) {
+		unique_ptr<Worker> worker(new Worker());
+		worker->epollFD = epoll_create1(0);
+		worker->wakeFD = eventfd(0, EFD_NONBLOCK);
+
+		struct epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = worker->wakeFD;
+		if (worker->epollFD < 0 || worker->wakeFD < 0 || epoll_ctl(worker->epollFD, EPOLL_CTL_ADD, worker->wakeFD, &event) < 0) {
+			cout << "Worker Setup Failed\n";
+			return 1;
+		}
 
-			// Are we done? Then stop the main socket loop
-			if (curPktNum == numPackets) {
-				break;
+		worker->workerThread = thread(runWorker, worker.get());
+		workers.push_back(move(worker));
+	}
 
-			// Is the last packet next? Identify remaining packet size for socket.
-			} else if ((curPktNum+1) == numPackets) {
-				int newPacketSize = fileSize % packetSize;
-				if (newPacketSize > 0) packetSize = newPacketSize; // Next packet will be different.
-			}
-		
-		// Length of "0"? Then the socket was closed.
-		} else if (socketData.length() == 0) {
-			cout << "Socket was closed...";
-			break;
-		}
+	// Create the socket and listen
+	NetSocket listenSocket;
+	if (!listenSocket.createListenSocket(portNum, 128)) {
+		return 1;
 	}
+	printf("Workers: %d | Max connections: %d | ACK every %d packets or %dms\n", numWorkers, maxConnections, ackEvery, ackDelayMS);
 
-	// Close our socket and file
-	clientSocket.closeSocket();
-	senderFile.close();
+	// Take connections FOR-EV-ER, spreading them across the workers
+	int nextSessionId = 1;
+	while (1) {
+		unique_ptr<ReceiverSession> session(new ReceiverSession(nextSessionId));
+		session->setAckPolicy(ackEvery, ackDelayMS);
+		if (!listenSocket.acceptConnection(session->getSocket())) {
+			continue;
+		}
 
-	// Math about the number of packets retransmitted
-	numRetrans = numReceived - numPackets;
+		// Too many already? Turn it away (the sender sees the connection close).
+		if (!startSession(maxConnections)) {
+			cout << "Connection limit reached - closing connection\n";
+			session->getSocket().closeSocket();
+			continue;
+		}
 
-	// Statistics!
-	printf("\n\n");
-	printf("Last packet seq# received: %d\n", lastReceived);
-	printf("Number of original packets received: %d\n", numPackets);
-	printf("Number of retransmitted packets received: %d\n\n", numRetrans);
+		session->getSocket().setNonBlocking();
+		session->getSocket().useAsyncIO();
+		handOver(workers[nextSessionId % numWorkers].get(), move(session));
+		nextSessionId++;
+	}
 
 	return 0;
 }
@@ -5,14 +5,31 @@
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <thread>
 #include <string>
 #include <unistd.h>
 #include <filesystem>
 #include <chrono>
 #include <algorithm>
+#include <climits>
+#include <deque>
+#include <fcntl.h>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/prctl.h>
 #include "Packet.h"
+#include "PacketPool.h"
+#include "SessionSetup.h"
 #include "NetSockets.h"
+#include "Checksum.h"
+#include "AsyncIO.h"
+#include "TimerWheel.h"
+#include "PacketWindow.h"
+#include "RTOEstimator.h"
+#include "CongestionControl.h"
+#include "Pacer.h"
 using namespace std;
 /**
  *
@@ -22,26 +39,79 @@ using namespace std;
 
 // Global Data
 mutex ackMutex;
+condition_variable ackCondition;    // Signalled (with ackMutex) when an ACK arrives or the ACK thread stops
 unsigned int curSeqNum = 0;      // Starts at 1 due to initial file details packet being 0.
 int numRetrans = 0;         // Number of retransmitted packets
-int timeoutMS;          // User-specified timeout in milliseconds
-int timeoutMulti;       // Multiplication factor for RTT
+int timeoutMS;          // User-specified timeout in milliseconds (0 = adaptive)
+int timeoutMulti = 1;   // Multiplication factor for RTT (adaptive timeout is at least this many RTTs)
+RTOEstimator rtoEstimator;  // Adaptive retransmission timeout (smoothed RTT + variance)
 int slidingWindowSize = -1;
+string congestionType;      // Congestion control: None, AIMD, CUBIC, or BBR
+unique_ptr<CongestionControl> congestionControl;    // Congestion window, up to slidingWindowSize (nullptr = always the full window)
+string pacingType;          // Pacing: 0 (none), a rate in Mbps, or Auto
+double pacingRateMbps = 0;  // Fixed pacing rate (0 = none, or Auto)
+bool isAutoPacing = false;  // Auto: pace at the congestion control's rate (or the window per round trip)
+Pacer pacer;                // Spreads new packets out at the pacing rate (no rate = as fast as the window allows)
 int slidingWindowFront = 1; // Track where we are in the start of the sliding window.
 int slidingWindowEnd = 0;   // Track where we are in the end of the sliding window
 int seqNumRange = 0;        // Sequence Number Range
-vector <unique_ptr<Packet> > packetList; // All of our active packets
+PacketPool packetPool;  // Packets (and their data) reused for every chunk - sized from the sliding window
+PacketWindow sendWindow;    // All of our active packets, by sequence number
+TimerWheel retransmitTimers;    // Retransmission timeout of every packet waiting on an ACK (tag = the packet)
+long long timerTimeNS = 0;      // Time spent starting, stopping and expiring those timers
+vector<uint64_t> timedOutPackets;   // Reused by checkPacketQueue() for the timers that expired
+vector<int> lostPackets;    // Congestion control: timed out packets waiting for the window to resend them (sequence #s)
+int numResendsInFlight = 0; // Congestion control: packets resendLostPackets() resent that aren't ACK'd (or timed out again) yet
+long long windowTimeNS = 0;     // Time spent finding ACK'd packets and sliding the window past them
+long long numACKsProcessed = 0; // ACKs looked up in the window
 NetSocket clientSocket; // Socket Connection
 int packetSize;         // Max packet size for data
 int numPackets;    // # of packets to send
 string protocolType;    // Protocol used (GBN or SR)
-bool keepReadACK = true;   // Do we keep reading for ACKs?
-bool hasACKClosed = false; // Indicate if the ACK thread successfully closed
-string artificialErrors;    // Errors: None, User, or Random
+bool isGoBackN = false;     // Go-Back-N: cumulative ACKs and one timer for the whole window
+int windowTimerId = -1;     // Go-Back-N: timer for the oldest packet not ACK'd yet (-1 = not running)
+int numGoBacks = 0;         // Go-Back-N: times we went back and resent the window
+bool useSelectiveAcks = false;  // SR: the receiver sends selective ACKs (SessionSetup::CAP_SACK)
+int reorderThreshold = 0;   // Fast retransmit: a packet this many behind one that was ACK'd is lost (0 = off)
+int highestAcked = 0;       // Fast retransmit: newest packet ACK'd so far
+int fastRetransmitPoint = 0;    // Fast retransmit: packets up to here were already checked (each one goes at most once)
+int lastCumulativeAck = 0;  // Go-Back-N: last cumulative ACK - the same one again is a duplicate
+int numDupAcks = 0;         // Go-Back-N: duplicates of it so far
+long long numFastRetransmits = 0;   // Packets resent (Go-Back-N: times we went back) without waiting for the timer
+long long numBitmapMarks = 0;   // Packets marked ACK'd from a selective ACK's bitmap
+atomic<bool> keepReadACK(true);   // Do we keep reading for ACKs?
+bool hasACKClosed = false; // Indicate if the ACK thread successfully closed (guarded by ackMutex)
+string artificialErrors;    // Errors: None, User, Random, or Reorder
 vector<int> errorDrop;      // Stores which packets the user specifies to drop (Forced error)
 vector<int> errorNACK;      // Stores which packets the user specifies to receive NACK (Forced error)
 vector<int> errorLostAck;   // Stores which packets the user specifies to lose ACK (Forced error)
-int RTT = 0;
+int reorderPercent = 0;     // Percentage of packets sent out of order (Reorder error)
+deque<pair<unsigned int, shared_ptr<const string>>> heldBackFrames;  // Packets held back (Reorder error) - sent once the sequence # goes out
+int headerVersion = Packet::HEADER_ASCII;  // Header format in use (switches to binary once the receiver accepts it)
+string integrityType;       // Integrity check requested: Checksum, CRC32C, or None
+int integrity = Packet::INTEGRITY_CHECKSUM; // Integrity check in use (once the receiver accepts it)
+string transportType;       // Transport requested: TCP or UDP
+long long ackLatencyTotalUS = 0;    // Send -> ACK time of packets sent only once
+int numAckLatencySamples = 0;
+AsyncIO fileIO;             // File reads (io_uring when the kernel has it)
+const int READ_AHEAD_BYTES = 256 * 1024;  // Read ahead of the sliding window (two halves - one is read while the other is sent)
+const int MIN_READ_AHEAD_DEPTH = 8;     // Chunks (big packets)
+const int MAX_READ_AHEAD_DEPTH = 1024;  // Chunks (tiny packets - keeps the io_uring ring small)
+const long long PREFETCH_BYTES = 8 * 1024 * 1024;  // The disk is asked to have this much past our reads in the page cache
+int readAheadDepth;         // Chunks read ahead of the sliding window
+long long prefetchedTo = 0; // File offset the disk was asked to read up to (posix_fadvise)
+long long readWaitNS = 0;   // Time spent waiting on a chunk that wasn't read yet
+long long numReadWaits = 0;
+const int MAX_WINDOW_DISPLAY = 64;  // Bigger windows are shown abbreviated
+const int MAX_REORDER_DISTANCE = 32;    // How many packets a reordered packet can be held back
+
+// A chunk of the file being read ahead
+struct ChunkRead {
+    PacketPool::Handle packet;  // Packet the chunk is read into
+    int chunkNum;               // Chunk # (also the read's tag)
+    bool isDone;                // Has the read finished?
+};
+deque<ChunkRead> chunkReads;    // Reads in flight, in file order
 
 
 /**
@@ -49,6 +119,8 @@ int RTT = 0;
  * 
  * The window shifts after each ack received.
  * Example: [1, 2, 3, 4, 5]
+ * 
+ * Big windows only show their ends (e.g. [1, 2, 3, 4, ..., 65536]) so a slide doesn't cost O(window).
  */
 void showSlidingWindow() {
 
@@ -62,6 +134,12 @@ void showSlidingWindow() {
     string windowDisplay = "Current window = [";
     for (int i = slidingWindowFront; i <= slidingWindowMax; i++) {
 
+        // Too many to show? Skip to the last one.
+        if (slidingWindowSize > MAX_WINDOW_DISPLAY && i == slidingWindowFront + 4) {
+            windowDisplay.append("..., ");
+            i = slidingWindowMax;
+        }
+
         // Display the number (how depends on range)
         if (seqNumRange > 0) {
             windowDisplay.append(to_string(i % seqNumRange));
@@ -82,26 +160,354 @@ void showSlidingWindow() {
 /**
  * @brief Find the packet associated with a sequence number
  * 
- * @return Packet* 
+ * @return Packet* (nullptr if it's no longer in the window)
  */
-vector<unique_ptr<Packet>>::iterator findPacketBySeqNum(int findSeqNum) {
-    // std::lock_guard<mutex> lock(ackMutex);
-    vector<unique_ptr<Packet>>::iterator iterator = packetList.begin();
-    while (iterator != packetList.end()) {
-        
-        // Find it?
-        if ((*iterator)->getSeqNum() == findSeqNum) {
+Packet *findPacketBySeqNum(int findSeqNum) {
+    return sendWindow.get(findSeqNum);
+}
 
-            // Return the reference to the packet.
-            return iterator;
+/**
+ * @brief How long to wait for an ACK before retransmitting
+ * 
+ * A timeout the user gave is used as is - otherwise it's the estimate from the round trips so far.
+ */
+chrono::microseconds getRetransmitTimeout() {
+    if (timeoutMS > 0) {
+        return chrono::milliseconds(timeoutMS);
+    }
+    return rtoEstimator.getTimeout();
+}
 
-            break;
-        } else {
-            iterator++;
+/**
+ * @brief How many packets we can have in flight right now
+ * 
+ * The user's sliding window - or less, if congestion control says so.
+ */
+int getSendWindowSize() {
+    if (congestionControl) {
+        return congestionControl->getWindow();
+    }
+    return slidingWindowSize;
+}
+
+/**
+ * @brief Size of a full packet on the wire (data + header)
+ */
+int getFrameSize() {
+    return packetSize + Packet::getHeaderSize(headerVersion, integrity);
+}
+
+/**
+ * @brief Keep the pacing rate in step with the congestion window and round trip (Auto pacing)
+ * 
+ * Without congestion control, it's the user's window per round trip (and a bit). Nothing is paced until there's a round trip.
+ */
+void updatePacingRate() {
+    if (!isAutoPacing) {
+        return;
+    }
+
+    double packetsPerSecond = 0;
+    if (congestionControl) {
+        packetsPerSecond = congestionControl->getPacingRate();
+    } else if (rtoEstimator.getNumSamples() > 0) {
+        packetsPerSecond = CongestionControl::PACING_GAIN * slidingWindowSize / rtoEstimator.getSmoothedUS() * 1000000;
+    }
+    pacer.setRate(packetsPerSecond * getFrameSize(), getFrameSize());
+}
+
+/**
+ * @brief Use a packet's round trip for the ACK latency and the retransmission timeout
+ * 
+ * Only a packet sent once is a clean sample - an ACK for a retransmitted one could be for either send (Karn's rule).
+ */
+void sampleRoundTrip(Packet *thePacket) {
+    if (thePacket->getNumSends() != 1) {
+        return;
+    }
+
+    long long rttUS = thePacket->getMicrosSinceSent();
+    ackLatencyTotalUS += rttUS;
+    numAckLatencySamples++;
+    rtoEstimator.addSample(rttUS);
+    if (congestionControl) {
+        congestionControl->onRoundTrip(rttUS, chrono::steady_clock::now());
+    }
+}
+
+/**
+ * @brief Mark a packet as ACK'd
+ * 
+ * Stops its retransmission timer - checkPacketQueue() removes it once the window slides past it.
+ * 
+ * @param isSample Use its round trip time? (only for the packet the ACK was sent for)
+ */
+void markAcked(Packet *thePacket, bool isSample) {
+    if (thePacket->getAck() == 1) {
+        return;
+    }
+
+    // Round trip (only the first ACK of a packet is a clean sample)
+    if (isSample) {
+        sampleRoundTrip(thePacket);
+    }
+
+    // One more packet delivered - congestion control can open the window
+    if (congestionControl) {
+        congestionControl->onAck(chrono::steady_clock::now());
+        if (thePacket->isResendCounted()) {
+            thePacket->setResendCounted(false);
+            numResendsInFlight--;
         }
     }
 
-    return packetList.end();
+    // No more retransmissions
+    chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+    retransmitTimers.cancel(thePacket->getTimerId());
+    thePacket->setTimerId(-1);
+    timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+
+    thePacket->setAck(1);
+    highestAcked = max(highestAcked, thePacket->getSeqNum());
+}
+
+/**
+ * @brief Resend the packets that later ones were ACK'd past (fast retransmit)
+ * 
+ * A packet reorderThreshold or more behind the newest one ACK'd isn't just running late - it's lost, so it goes again
+ *      now instead of when its timer runs out. Each packet only goes once this way (if that's lost too, its timer takes over).
+ */
+void fastRetransmit() {
+    if (reorderThreshold <= 0) {
+        return;
+    }
+
+    int lastLost = min(highestAcked - reorderThreshold, slidingWindowEnd);
+    for (int seqNum = max(slidingWindowFront, fastRetransmitPoint + 1); seqNum <= lastLost; seqNum++) {
+        Packet *thePacket = sendWindow.get(seqNum);
+
+        // ACK'd, or already waiting for the congestion window to resend it?
+        if (thePacket == nullptr || thePacket->getAck() == 1 || thePacket->getTimerId() < 0) {
+            continue;
+        }
+
+        // Retransmit the packet (and restart its timer)
+        clientSocket.sendData(*thePacket->getFrame());
+        thePacket->markSent();
+        chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+        retransmitTimers.reschedule(thePacket->getTimerId(), timerStart + getRetransmitTimeout());
+        timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+        printf("Packet %d Fast re-transmitted\n", thePacket->showSeqNum());
+
+        numRetrans++;
+        numFastRetransmits++;
+
+        // ...and send less (once per round trip, however many were lost)
+        if (congestionControl) {
+            congestionControl->onLoss(timerStart, false);
+        }
+    }
+    fastRetransmitPoint = max(fastRetransmitPoint, lastLost);
+}
+
+/**
+ * @brief Restart Go-Back-N's window timer
+ * 
+ * There's one timer for the whole window - it runs for the oldest packet that isn't ACK'd yet.
+ * 
+ * @param hasOutstanding Are any packets still waiting on an ACK? (otherwise it's just stopped)
+ */
+void restartWindowTimer(bool hasOutstanding) {
+    chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+    retransmitTimers.cancel(windowTimerId);
+    windowTimerId = (hasOutstanding) ? retransmitTimers.schedule(timerStart + getRetransmitTimeout(), 0) : -1;
+    timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+}
+
+/**
+ * @brief Resend timed out packets as the congestion window allows (oldest first)
+ * 
+ * The packets in timedOutPackets join the ones still waiting. Each resend counts against the window
+ * 		until it's ACK'd or times out again - so after a timeout (window of 1) they trickle out as the
+ * 		ACKs come back, instead of all at once into the queue that just overflowed.
+ */
+void resendLostPackets() {
+    for (size_t i = 0; i < timedOutPackets.size(); i++) {
+        Packet *timedOutPacket = (Packet *) (uintptr_t) timedOutPackets[i];
+        printf("Packet %d ***** Timed Out *****\n", timedOutPacket->showSeqNum());
+
+        timedOutPacket->setTimerId(-1);
+        if (timedOutPacket->isResendCounted()) {
+            timedOutPacket->setResendCounted(false);
+            numResendsInFlight--;
+        }
+        lostPackets.push_back(timedOutPacket->getSeqNum());
+    }
+    sort(lostPackets.begin(), lostPackets.end());
+
+    // Resend from the oldest - anything ACK'd in the meantime (or slid past) just leaves the line
+    int numAllowed = congestionControl->getWindow() - numResendsInFlight;
+    size_t numKept = 0;
+    for (size_t i = 0; i < lostPackets.size(); i++) {
+        Packet *lostPacket = sendWindow.get(lostPackets[i]);
+        if (lostPacket == nullptr || lostPacket->getAck() == 1) {
+            continue;
+        }
+        if (numAllowed <= 0) {
+            lostPackets[numKept++] = lostPackets[i];
+            continue;
+        }
+
+        clientSocket.sendData(*lostPacket->getFrame());
+        lostPacket->markSent();
+        printf("Packet %d Re-transmitted\n", lostPacket->showSeqNum());
+        numRetrans++;
+        numResendsInFlight++;
+        lostPacket->setResendCounted(true);
+        numAllowed--;
+
+        chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+        lostPacket->setTimerId(retransmitTimers.schedule(timerStart + getRetransmitTimeout(), (uint64_t) (uintptr_t) lostPacket));
+        timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+    }
+    lostPackets.resize(numKept);
+}
+
+/**
+ * @brief Go back N - resend every packet from a sequence number to the end of the window
+ * 
+ * The receiver throws away everything after the packet it's missing, so all of those go again.
+ */
+void goBackN(int fromSeqNum) {
+    printf("Going back to packet %d\n", (seqNumRange > 0) ? fromSeqNum % seqNumRange : fromSeqNum);
+
+    for (int seqNum = fromSeqNum; seqNum <= slidingWindowEnd; seqNum++) {
+        Packet *thePacket = sendWindow.get(seqNum);
+        if (thePacket == nullptr || thePacket->getAck() == 1) {
+            continue;
+        }
+
+        clientSocket.queueFrame(thePacket->getFrame());
+        thePacket->markSent();
+        printf("Packet %d Re-transmitted\n", thePacket->showSeqNum());
+        numRetrans++;
+    }
+    clientSocket.flushQueue();
+    numGoBacks++;
+
+    restartWindowTimer(true);
+}
+
+/**
+ * @brief Handle a cumulative ACK (Go-Back-N)
+ * 
+ * The ACK covers every packet up to its sequence number. Older ones (duplicates) tell us nothing new.
+ */
+void handleCumulativeAck(Packet &ackPacket) {
+    int ackSeqNum = ackPacket.getSeqNum();
+
+    // Damaged packet? The receiver threw it away (and everything after it) - go back to it now.
+    if (ackPacket.getAck() != Packet::ACK_OK) {
+        printf("Failure ack %d received\n", ackPacket.showSeqNum());
+        if (ackSeqNum >= slidingWindowFront && ackSeqNum <= slidingWindowEnd) {
+            goBackN(ackSeqNum);
+        }
+        return;
+    }
+
+    // The same ACK again, with packets still out? The receiver is throwing away what came after a lost one - after
+    // reorderThreshold of them, go back now instead of waiting for the timer (fast retransmit).
+    if (ackSeqNum == lastCumulativeAck && ackSeqNum < slidingWindowEnd) {
+        printf("Ack %d received (duplicate)\n", ackPacket.showSeqNum());
+        if (reorderThreshold > 0 && ++numDupAcks == reorderThreshold) {
+            numFastRetransmits++;
+            if (congestionControl) {
+                congestionControl->onLoss(chrono::steady_clock::now(), false);
+            }
+            goBackN(ackSeqNum + 1);
+        }
+        return;
+    }
+
+    if (ackSeqNum < slidingWindowFront || ackSeqNum > slidingWindowEnd) {
+        return;
+    }
+    printf("Ack %d received (cumulative)\n", ackPacket.showSeqNum());
+    lastCumulativeAck = ackSeqNum;
+    numDupAcks = 0;
+
+    // Mark everything it covers - checkPacketQueue() slides the window past them.
+    chrono::steady_clock::time_point markStart = chrono::steady_clock::now();
+    for (int seqNum = slidingWindowFront; seqNum <= ackSeqNum; seqNum++) {
+        Packet *thePacket = sendWindow.get(seqNum);
+        if (thePacket != nullptr) {
+            markAcked(thePacket, seqNum == ackSeqNum);
+        }
+    }
+    windowTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - markStart).count();
+
+    // The timer now runs for the next packet (if there is one)
+    restartWindowTimer(ackSeqNum < slidingWindowEnd);
+    ackCondition.notify_one();
+}
+
+/**
+ * @brief Handle a selective ACK (SR)
+ * 
+ * The sequence number is the last packet the receiver has in order, so it covers everything up
+ * 		to there. The data is a bitmap of the packets after it that the receiver has buffered
+ * 		(bit i = sequence number + 1 + i) - one ACK marks all of them, and a lost one costs nothing
+ * 		as long as a later one gets through.
+ * 
+ * Its round trip is sampled from the newest packet it covers for the first time - the one that
+ * 		made the receiver send it.
+ */
+void handleSelectiveAck(Packet &ackPacket) {
+    int ackSeqNum = ackPacket.getSeqNum();
+    printf("Ack %d received (selective)\n", ackPacket.showSeqNum());
+
+    chrono::steady_clock::time_point markStart = chrono::steady_clock::now();
+
+    Packet *newestAcked = nullptr;  // Newest packet this ACK covers for the first time
+
+    // Everything up to the cumulative point
+    for (int seqNum = slidingWindowFront; seqNum <= min(ackSeqNum, slidingWindowEnd); seqNum++) {
+        Packet *thePacket = sendWindow.get(seqNum);
+        if (thePacket != nullptr && thePacket->getAck() != 1) {
+            markAcked(thePacket, false);
+            newestAcked = thePacket;
+        }
+    }
+
+    // Everything after it that the receiver has buffered
+    DataView bitmap = ackPacket.getDataView();
+    for (size_t i = 0; i < bitmap.size; i++) {
+        if (bitmap.data[i] == 0) {
+            continue;
+        }
+
+        for (int bit = 0; bit < 8; bit++) {
+            if ((bitmap.data[i] >> bit) & 1) {
+                Packet *thePacket = sendWindow.get(ackSeqNum + 1 + (int) i * 8 + bit);
+                if (thePacket != nullptr && thePacket->getAck() != 1) {
+                    markAcked(thePacket, false);
+                    newestAcked = thePacket;
+                    numBitmapMarks++;
+                }
+            }
+        }
+    }
+    windowTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - markStart).count();
+
+    // One round trip per ACK
+    if (newestAcked != nullptr) {
+        sampleRoundTrip(newestAcked);
+    }
+
+    // Anything left behind what it covers?
+    fastRetransmit();
+
+    ackCondition.notify_one();
 }
 
 /**
@@ -113,69 +519,117 @@ vector<unique_ptr<Packet>>::iterator findPacketBySeqNum(int findSeqNum) {
  * Once it constructs and sends the information, it'll wait to receive a successful ACK request
  *      before moving forward. If this process fails, the file will not be sent.
  * 
+ * The details are sent as session setup options (see SessionSetup). The ACK carries the options
+ *      the receiver accepted, which decide the header format and integrity check from here on.
+ * 
  * @param outFileName Output Name of the file being sent
  * @param fileSize Size of the file being sent
+ * @return bool (false = the receiver closed the connection)
  */
-void sendInitialFilePacket(string outFileName, int fileSize) {
+bool sendInitialFilePacket(string outFileName, long long fileSize) {
 
     // Construct the initial packet
-    //      Due to the difference in information, we need to know where each piece of data
-    //          starts and ends for safety. So we do this by padding the numbers into defined lengths.
-
-    // Pad the file size to 16 bytes
-    string fileSizeStr = to_string(fileSize);
-    string padFileSize = string(16 - fileSizeStr.length(), '0').append(fileSizeStr);
-
-    // Pad the file size to 16 bytes
-    string numPacketsStr = to_string(numPackets);
-    string padNumPackets = string(16 - numPacketsStr.length(), '0').append(numPacketsStr);
-
-    // Pad the packet size to 16 bytes
-    string packetSizeStr = to_string(packetSize);
-    string padPacketSize = string(16 - packetSizeStr.length(), '0').append(packetSizeStr);
-
-    // Pad the window size to 16 bytes  (Go-Back-N uses "1" for receiver)
-    string slidingWindowSizeStr = (protocolType == "GBN") ? "1" : to_string(slidingWindowSize);
-    string padSlidingWindowSize = string(16 - slidingWindowSizeStr.length(), '0').append(slidingWindowSizeStr);
-
-    // Pad the protocol to 3 bytes
-    string padProtocolType = string(3 - protocolType.length(), ' ').append(protocolType);
-
-    // Pad the packet size to 16 bytes
-    string seqNumRangeStr = to_string(seqNumRange);
-    string padSeqNumRange = string(16 - seqNumRangeStr.length(), '0').append(seqNumRangeStr);
-
-    // Create the data string for the packet
-    string packetData = padFileSize + padNumPackets + padPacketSize + padSlidingWindowSize + padProtocolType + padSeqNumRange + outFileName;
+    SessionSetup offer;
+    offer.fileSize = fileSize;
+    offer.numPackets = numPackets;
+    offer.packetSize = packetSize;
+    offer.windowSize = (protocolType == "GBN") ? 1 : slidingWindowSize; // Go-Back-N uses "1" for receiver
+    offer.protocol = protocolType;
+    offer.seqNumRange = seqNumRange;
+    offer.fileName = outFileName;
+
+    // Offer the binary header format - the receiver tells us in its ACK whether it accepts.
+    offer.headerVersion = Packet::HEADER_BINARY;
+
+    // Offer selective ACKs (SR only - Go-Back-N's ACKs are cumulative already)
+    if (protocolType == "SR") {
+        offer.capabilities |= SessionSetup::CAP_SACK;
+    }
 
-    // Convert the data to char
-    vector<char> packetDataChar(packetData.begin(), packetData.end());
+    // Offer the integrity check (needs the binary header)
+    offer.integrity = Packet::INTEGRITY_CHECKSUM;
+    if (integrityType == "CRC32C") {
+        offer.integrity = Packet::INTEGRITY_CRC32C;
+    } else if (integrityType == "None") {
+        offer.integrity = Packet::INTEGRITY_NONE;
+    }
 
-    // Append a null byte to the end
-    packetDataChar.push_back('\0');
+    string packetData = offer.encode();
 
-    // TODO: Filename (sometimes?) has extra character added.
+    // The initial packet always uses the ASCII header since we don't know what the receiver supports yet.
     Packet initialPacket = Packet();
+    initialPacket.setHeaderVersion(Packet::HEADER_ASCII);
     initialPacket.setSeqNum(0);
-    initialPacket.setData(packetDataChar);
+    initialPacket.setDataView({ packetData.data(), packetData.length() });
 
-    // Send the packet
-    clientSocket.sendData(initialPacket.createPacketString());
+    // Send the packet - its round trip is the first sample for the retransmission timeout
+    clientSocket.sendData(*initialPacket.getFrame());
+    chrono::steady_clock::time_point sentTimePoint = chrono::steady_clock::now();
+    bool isResent = false;
 
     // Wait until we receive an acknowledgement
     while (1) {
-        string socketData = clientSocket.getFromSocket(0);
+        // Datagrams can be lost - send the initial packet again if the ACK doesn't show up in time.
+        if (!clientSocket.waitForData(max(timeoutMS, 100))) {
+            if (clientSocket.getTransport() == NetSocket::TRANSPORT_UDP) {
+                clientSocket.sendData(*initialPacket.getFrame());
+                isResent = true;
+                printf("Packet 0 Re-transmitted\n");
+            }
+            continue;
+        }
+
+        string socketData = clientSocket.getFromSocket();
+
+        // The receiver closed the connection (e.g. it's at its connection limit)
+        if (clientSocket.isClosed()) {
+            printf("Connection closed by the receiver\n");
+            return false;
+        }
+
 		if (socketData.length() > 0) {
-            
+
+            // Sent more than once? Then we can't tell which send it's for (Karn's rule).
+            if (!isResent) {
+                rtoEstimator.addSample(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - sentTimePoint).count());
+            }
+
             Packet ackPacket = Packet();
-            ackPacket.reversePacket(socketData);
+            ackPacket.reversePacketView(socketData.data(), socketData.length());
             ackPacket.setSeqNumRange(seqNumRange);
             printf("Ack %d received\n", ackPacket.showSeqNum());
 
+            // Switch to what the receiver accepted (anything missing stays ASCII + checksum)
+            SessionSetup accepted;
+            DataView ackData = ackPacket.getDataView();
+            if (accepted.decode(ackData.data, ackData.size)) {
+                if (accepted.headerVersion == Packet::HEADER_BINARY) {
+                    headerVersion = Packet::HEADER_BINARY;
+                }
+
+                // Same for the integrity check (only possible with the binary header)
+                if (headerVersion == Packet::HEADER_BINARY && accepted.integrity >= 0) {
+                    integrity = accepted.integrity;
+                }
+
+                useSelectiveAcks = (offer.capabilities & accepted.capabilities & SessionSetup::CAP_SACK) != 0;
+            }
+            // Datagram slots only need to fit ACKs from here on (a repeat of this one, or a selective ACK's bitmap for the whole window)
+            size_t maxAckDataSize = (useSelectiveAcks) ? (slidingWindowSize + 7) / 8 : 1;
+            clientSocket.setMaxFrameSize(max(socketData.length(), (size_t) Packet::getHeaderSize(headerVersion, integrity) + maxAckDataSize));
+
+            printf("Using %s packet headers | Integrity: %s%s\n", (headerVersion == Packet::HEADER_BINARY) ? "binary" : "ASCII", Packet::getIntegrityName(integrity).c_str(),
+                (useSelectiveAcks) ? " | Selective ACKs" : "");
+            if (timeoutMS == 0) {
+                printf("Dynamic timeout starts at %.1f milliseconds (round trip %.1fus).\n", getRetransmitTimeout().count() / 1000.0, rtoEstimator.getSmoothedUS());
+            }
+
             // No longer need the packet
             break;
         }
     }
+
+    return true;
 }
 
 /**
@@ -187,18 +641,37 @@ void sendInitialFilePacket(string outFileName, int fileSize) {
  * As packets come in, it'll determine if the packet was successfully send, or if it'll need to resend it.
  */
 void readACKMessages() {
+    Packet ackPacket = Packet(); // Reused for every ACK
+
     while (keepReadACK) {
-        string socketData = clientSocket.getFromSocket(1); // Grab the ACK
-		if (socketData.length() > 0) {
+        // Sleep until an ACK arrives - stopReceiving() wakes us when we're no longer needed.
+        if (!clientSocket.waitForData(-1)) {
+            continue;
+        }
+
+        // Grab the next ACK - ACKs that arrived together are handed out without another recv()
+        const char *frameData;
+        size_t frameLen;
+        if (!clientSocket.getFrame(frameData, frameLen)) {
+            if (clientSocket.isClosed()) {
+                break; // No more ACKs are coming
+            }
+            continue;
+        }
+
+		if (frameLen > 0) {
             std::lock_guard<mutex> lock(ackMutex);
-            Packet ackPacket = Packet();
-            ackPacket.reversePacket(socketData);
+            ackPacket.reversePacketView(frameData, frameLen);
             ackPacket.setSeqNumRange(seqNumRange);
 
             // check if sequence number of the received packet is in the errorLostAck vector
-            if (!errorLostAck.empty() && ackPacket.getSeqNum() == errorLostAck.front()) {
-                //erase first element of error vector
-                errorLostAck.erase(errorLostAck.begin());
+            // - A cumulative ACK that goes past it is the one that would have covered it.
+            bool isCumulative = (isGoBackN || useSelectiveAcks) && ackPacket.getAck() == Packet::ACK_OK;
+            if (!errorLostAck.empty() && (ackPacket.getSeqNum() == errorLostAck.front() || (isCumulative && ackPacket.getSeqNum() > errorLostAck.front()))) {
+                //erase the errors it covers from the error vector
+                while (!errorLostAck.empty() && errorLostAck.front() <= ackPacket.getSeqNum()) {
+                    errorLostAck.erase(errorLostAck.begin());
+                }
 
                 // pretend that the Ack was lost
                 continue;
@@ -212,45 +685,116 @@ void readACKMessages() {
                 }
             }
 
+            // Go-Back-N - the ACK covers everything up to it
+            if (isGoBackN) {
+                numACKsProcessed++;
+                handleCumulativeAck(ackPacket);
+                continue;
+            }
+
+            // Selective ACK - covers everything up to it, plus what its bitmap says (failures are still for one packet)
+            if (useSelectiveAcks && ackPacket.getAck() == Packet::ACK_OK) {
+                numACKsProcessed++;
+                handleSelectiveAck(ackPacket);
+                continue;
+            }
+
             // Find the packet associated with our ACK'd response
-            vector<unique_ptr<Packet>>::iterator thePacket = findPacketBySeqNum(ackPacket.getSeqNum());
+            chrono::steady_clock::time_point findStart = chrono::steady_clock::now();
+            Packet *thePacket = findPacketBySeqNum(ackPacket.getSeqNum());
+            windowTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - findStart).count();
+            numACKsProcessed++;
 
             // Make sure we found the packet
-            if (thePacket != packetList.end()) {
-
-                // Reset the timeout (we got the packet)
-                (*thePacket)->setTimeout(500);
+            if (thePacket != nullptr) {
 
                 if (ackPacket.getAck() == Packet::ACK_OK) {
                     printf("Ack %d received\n", ackPacket.showSeqNum());
 
                     // Mark that we got the ack - we'll delete it and shift the sliding window in checkPacketQueue()
                     // - This way we handle if the ACKs come out of order.
-                    (*thePacket)->setAck(1);
+                    markAcked(thePacket, true);
+                    fastRetransmit();
+                    ackCondition.notify_one();
                     
                 // // ACK failure - retransmit.
                 } else {
                     printf("Failure ack %d received\n", ackPacket.showSeqNum());
 
-                    // Retransmit the packet
-                    clientSocket.sendData((*thePacket)->createPacketString());
-                    printf("Packet %d Re-transmitted \n", (*thePacket)->showSeqNum());
+                    // Retransmit the packet (and restart its timer)
+                    clientSocket.sendData(*thePacket->getFrame());
+                    thePacket->markSent();
+                    chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+                    retransmitTimers.reschedule(thePacket->getTimerId(), timerStart + getRetransmitTimeout());
+                    timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+                    printf("Packet %d Re-transmitted \n", thePacket->showSeqNum());
 
                     numRetrans++;
                 }
             }
         }
     }
-    hasACKClosed = true;
+
+    // Let anyone waiting on ACKs know none are coming
+    {
+        std::lock_guard<mutex> lock(ackMutex);
+        hasACKClosed = true;
+    }
+    ackCondition.notify_all();
+}
+
+/**
+ * @brief Queue the packets held back for reordering
+ * 
+ * @param sendAll Queue them all (e.g. we're about to wait on the window) instead of only the ones that are due
+ */
+void releaseHeldBackFrames(bool sendAll) {
+    deque<pair<unsigned int, shared_ptr<const string>>>::iterator iterator = heldBackFrames.begin();
+    while (iterator != heldBackFrames.end()) {
+        if (sendAll || iterator->first <= curSeqNum) {
+            clientSocket.queueFrame(iterator->second);
+            iterator = heldBackFrames.erase(iterator);
+        } else {
+            iterator++;
+        }
+    }
+}
+
+/**
+ * @brief A chunk read finished - mark it done
+ *
+ * Chunks are read in order, so the tag says where it is in the read-ahead.
+ * @return bool (false = the read failed or came up short)
+ */
+bool markChunkRead(const AsyncIO::Completion &completion) {
+    ChunkRead &chunkRead = chunkReads[completion.tag - chunkReads.front().chunkNum];
+    chunkRead.isDone = true;
+
+    return completion.result == (long long) chunkRead.packet->getDataSize();
+}
+
+/**
+ * @brief Have the disk read ahead of us (posix_fadvise only starts the reads, it doesn't wait)
+ *
+ * Asks for PREFETCH_BYTES past the read offset, once half of the last request is used up.
+ */
+void prefetchFile(int inFileFD, long long readOffset) {
+    if (readOffset + PREFETCH_BYTES / 2 < prefetchedTo) {
+        return;
+    }
+
+    long long prefetchEnd = readOffset + PREFETCH_BYTES;
+    posix_fadvise(inFileFD, max(readOffset, prefetchedTo), prefetchEnd - max(readOffset, prefetchedTo), POSIX_FADV_WILLNEED);
+    prefetchedTo = prefetchEnd;
 }
 
 /**
  * @brief Process chunk data
  * 
  * This function is what handles taking pieces of the broken up file and sending it through the socket.
- * @param chunkData 
+ * @param newPacket Pooled packet already holding the chunk data
  */
-void processChunkData(vector <char> chunkData) {
+void processChunkData(PacketPool::Handle newPacket) {
     std::lock_guard<mutex> lock(ackMutex);
 
     // Increase the sequence number
@@ -259,15 +803,12 @@ void processChunkData(vector <char> chunkData) {
     // Move the ending window size - we trust other code to keep this in check.
     slidingWindowEnd++;
 
-    // Create the packet we want to send to the receiver
-    unique_ptr<Packet> newPacket(new Packet());
-    newPacket->setTimeout(timeoutMS);
+    // Fill in the packet we want to send to the receiver
+    newPacket->setHeaderVersion(headerVersion);
+    newPacket->setIntegrity(integrity);
     newPacket->setSeqNum(curSeqNum);        // Set the sequence number
     newPacket->setSeqNumRange(seqNumRange);  // Set the sequence range
 
-    // Set the data
-    newPacket->setData(chunkData);
-
     // Force errorNACK
     bool forceNACK = false;
 
@@ -304,13 +845,35 @@ void processChunkData(vector <char> chunkData) {
 
     // Do we send the data?
     if (sendPacketData) {
-        // Compile and send the packet data through the socket.
-        clientSocket.sendData(newPacket->createPacketString(forceNACK));
+        // Compile the packet data and queue it - checkPacketQueue() sends the queue once the window is full.
+        shared_ptr<const string> frame = newPacket->getFrame(forceNACK);
+
+        // Send it out of order? Hold it back until a few more packets have gone. (FORCED ERROR)
+        if (artificialErrors == "Reorder" && (rand() % 100) < reorderPercent) {
+            heldBackFrames.push_back(make_pair(curSeqNum + 1 + (rand() % MAX_REORDER_DISTANCE), frame));
+            printf("(Force Reorder): %d\n", newPacket->showSeqNum());
+        } else {
+            clientSocket.queueFrame(frame);
+        }
+        releaseHeldBackFrames(false);
+        pacer.onSend(chrono::steady_clock::now(), frame->length());
     }
+    newPacket->markSent();
     printf("Packet %d sent\n", newPacket->showSeqNum());
 
+    // Start the retransmission timer (Go-Back-N has one for the window - it's already running if anything is outstanding)
+    if (isGoBackN) {
+        if (windowTimerId < 0) {
+            restartWindowTimer(true);
+        }
+    } else {
+        chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+        newPacket->setTimerId(retransmitTimers.schedule(timerStart + getRetransmitTimeout(), (uint64_t) (uintptr_t) newPacket.get()));
+        timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+    }
+
     // Add the packet to the list of packets in progress.
-    packetList.push_back(move(newPacket));
+    sendWindow.put(move(newPacket));
 
 }
 
@@ -321,126 +884,146 @@ void processChunkData(vector <char> chunkData) {
  *      A) The first packet in the queue isn't the start of the window size.
  *      B) We haven't hit the end of our sliding window size
  * 
- * If we detect a packet that has timed out without a ACK, it also resends the packet.
+ * If a packet's retransmission timer has expired without an ACK, it also resends the packet.
+ * 
+ * Between passes we sleep until an ACK arrives or the next packet times out, whichever comes first.
+ * 
+ * @return bool (false = the connection closed - stop sending)
  */
-void checkPacketQueue(bool waitTillFinish = false) {
+bool checkPacketQueue(bool waitTillFinish = false) {
+
+    // We do need to lock due to use from the ACK thread constantly making updates (it's released while we sleep).
+    std::unique_lock<mutex> lock(ackMutex);
 
     // Keep going until we decide to move forward.
     while (1) {
-        // TODO: Determine if locking will cause issues in infinite loop...
-        // We do need to lock due to use from the ACK thread constantly making updates.
-        std::lock_guard<mutex> lock(ackMutex);
+        bool isPaceWait = false;    // Waiting for the next packet's turn (pacing)?
+        chrono::steady_clock::time_point paceTime;
 
-        // Process to see if we need to retransmit any packets
-        vector<unique_ptr<Packet>>::iterator iterator = packetList.begin();
-        while (iterator != packetList.end()) {
+        // Is the packet at the front of our sliding window marked as ACK'd?
+        // - Then we can adjust the sliding window and remove it.
+        while (sendWindow.has(slidingWindowFront) && sendWindow.get(slidingWindowFront)->getAck() == 1) {
 
-            // Is this packet next in our list for our sliding window *and* it has a marked ACK?
-            // - Then we can adjust the sliding window and remove it.
-            if ((*iterator)->getSeqNum() == slidingWindowFront && (*iterator)->getAck() == 1) {
-                slidingWindowFront++;
+            // Take the packet out of the window (back to the pool)
+            chrono::steady_clock::time_point slideStart = chrono::steady_clock::now();
+            sendWindow.take(slidingWindowFront);
+            windowTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - slideStart).count();
+            slidingWindowFront++;
 
-                // Erase the packet from the list
-                iterator = packetList.erase(iterator);
+            // Show the current sliding window.
+            showSlidingWindow();
+        }
 
-                // Show the current sliding window.
-                showSlidingWindow();
+        // No ACK thread? Then nothing we're waiting for will ever come.
+        // - The receiver closes once it has everything, so its last ACKs can beat us here - those still count.
+        if (hasACKClosed && sendWindow.size() > 0) {
+            printf("Connection closed - no more ACKs\n");
+            return false;
+        }
 
-                continue;
+        // About to wait on the window (or the end of the file)? Send every queued packet in one go first.
+        if (waitTillFinish || slidingWindowEnd >= slidingWindowFront + getSendWindowSize() - 1) {
+            releaseHeldBackFrames(true);
+            clientSocket.flushQueue();
+        }
 
-            // Did we hit the timeout?
-            } else if ((*iterator)->hasTimedOut()) {
-                printf("Packet %d ***** Timed Out *****\n", (*iterator)->showSeqNum());
+        // Retransmit the packets that timed out - only those are touched, however big the window is.
+        chrono::steady_clock::time_point timerStart = chrono::steady_clock::now();
+        timedOutPackets.clear();
+        retransmitTimers.getExpired(timerStart, timedOutPackets);
+        timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+
+        // Timed out? Wait twice as long next time (until an ACK gives us a fresh round trip) - but only
+        // when the oldest packet does, like a single connection timer would. A burst of losses expires
+        // over several passes, and shouldn't double the timeout for every one of them.
+        if (!timedOutPackets.empty()) {
+            bool hasFrontTimedOut = isGoBackN;
+            for (size_t i = 0; i < timedOutPackets.size() && !hasFrontTimedOut; i++) {
+                hasFrontTimedOut = ((Packet *) (uintptr_t) timedOutPackets[i])->getSeqNum() == slidingWindowFront;
+            }
+            if (hasFrontTimedOut) {
+                rtoEstimator.backOff();
+            }
 
-                // Set a new timeout
-                (*iterator)->setTimeout(timeoutMS);
+            // ...and send less - nothing got through for a whole timeout
+            if (congestionControl) {
+                congestionControl->onLoss(timerStart, true);
+            }
+        }
 
-                // TODO: Add max retransmission (just a constant?)
+        // Go-Back-N - the window timer went off, so the whole window goes again.
+        if (isGoBackN && !timedOutPackets.empty()) {
+            windowTimerId = -1;
+            printf("Packet %d ***** Timed Out *****\n", (seqNumRange > 0) ? slidingWindowFront % seqNumRange : slidingWindowFront);
+            goBackN(slidingWindowFront);
+            timedOutPackets.clear();
+        }
 
-                // TODO: Go-Back-N - Do we just let packets timeout that get sent after the 'missing' one, or do we have to indicate why we are retransmitting.
+        // Congestion control? Timed out packets wait in line (oldest first) and only go again as the
+        // (just cut) window allows - ACKs for what's resent open it back up.
+        if (congestionControl) {
+            resendLostPackets();
+            timedOutPackets.clear();
+        }
 
-                // Retransmit the packet
-                clientSocket.sendData((*iterator)->createPacketString());
-                printf("Packet %d Re-transmitted\n", (*iterator)->showSeqNum());
-                numRetrans++;
+        for (size_t i = 0; i < timedOutPackets.size(); i++) {
+            Packet *timedOutPacket = (Packet *) (uintptr_t) timedOutPackets[i];
+            printf("Packet %d ***** Timed Out *****\n", timedOutPacket->showSeqNum());
 
-                // TODO: If this is Go-Back-N and this was the beginning of the sliding window, we 
-                //      need to throw away all other following packets and run them again.
-            }
+            // TODO: Add max retransmission (just a constant?)
 
-            ++iterator;
+            // Retransmit the packet
+            clientSocket.sendData(*timedOutPacket->getFrame());
+            timedOutPacket->markSent();
+            printf("Packet %d Re-transmitted\n", timedOutPacket->showSeqNum());
+            numRetrans++;
+
+            // Set a new timeout
+            timerStart = chrono::steady_clock::now();
+            timedOutPacket->setTimerId(retransmitTimers.schedule(timerStart + getRetransmitTimeout(), timedOutPackets[i]));
+            timerTimeNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
         }
 
         // If we're waiting until we finish, then just see if we have any packets remaining.
         if (waitTillFinish) {
             // Do we still have packets remaining? 
-            if (packetList.size() == 0) {
-                break;
+            if (sendWindow.size() == 0) {
+                return true;
             }
 
         // We wait until the sliding window moves
         } else {
 
-            // Are we allowed to continue to the next packet?
-            int slidingWindowMax = slidingWindowFront + slidingWindowSize - 1;
+            // Are we allowed to continue to the next packet? (congestion control can hold us below the full window)
+            int slidingWindowMax = slidingWindowFront + getSendWindowSize() - 1;
             if (slidingWindowEnd < slidingWindowMax) {
-                break;
-            }
-        }
-    }
-}
 
-/**
- * @brief Calculate the timeout dynamically
- * 
- * Ping the server 3 times and keep track of the time involved. 
- * - Once successful, get the average time and use that as our timeout.
- */
-void calculateDynamicTimeout() {
-
-    chrono::steady_clock::time_point timeRTTStart;
-    chrono::steady_clock::time_point timeRTTEnd;
-    int totalTimeMS = 0;
-    
-
-    // Contact the socket three times
-    for (int i = 0; i < 3; i++) {
-        
-        // Run the next attempt.
-        timeRTTStart = std::chrono::steady_clock::now();
-        
-        clientSocket.sendData("PING");
-
-        // Wait until we receive an acknowledgement
-        while (1) {
-            string socketData = clientSocket.getFromSocket(0);
-            if (socketData.length() > 0) {     
-
-                // Did we get the PING?       
-                if (socketData.substr(0, 4) == "PING") {
-                    break;
+                // Paced? Only if it's the next packet's turn - what's queued goes out (in one batch) while it waits.
+                updatePacingRate();
+                paceTime = chrono::steady_clock::now();
+                if (pacer.canSend(paceTime)) {
+                    return true;
                 }
+                pacer.onWait(paceTime);
+                paceTime = pacer.getSendTime(paceTime);
+                isPaceWait = true;
+                clientSocket.flushQueue();
             }
         }
-        timeRTTEnd = std::chrono::steady_clock::now();
-
-        // Convert the time to milliseconds and add it to our total time.
-        auto timeRTTMS = chrono::duration_cast<chrono::milliseconds>(timeRTTEnd - timeRTTStart);
-        auto timeRTTSec = chrono::duration_cast<chrono::seconds>(timeRTTEnd - timeRTTStart);
-        RTT = timeRTTSec.count();
 
-        // RTT so fast we did it in less than a millisecond? Default to a millisecond * factor.
-        if (timeRTTMS.count() == 0) {
-            totalTimeMS += timeoutMulti;
+        // Sleep until an ACK arrives, the next timeout, or the next packet's turn
+        chrono::steady_clock::time_point wakeTime;
+        bool hasWakeTime = retransmitTimers.getNextWakeTime(wakeTime);
+        if (isPaceWait && (!hasWakeTime || paceTime < wakeTime)) {
+            wakeTime = paceTime;
+            hasWakeTime = true;
+        }
+        if (hasWakeTime) {
+            ackCondition.wait_until(lock, wakeTime);
         } else {
-            totalTimeMS += (timeRTTMS.count() * timeoutMulti);
+            ackCondition.wait(lock);
         }
     }
-
-    // Calculate the final time, with a minimum timeout of 1ms
-    timeoutMS = max(1, totalTimeMS / 3);
-
-    printf("Dynamic timeout set to %d milliseconds.\n", timeoutMS);
 }
 
 /**
@@ -562,6 +1145,7 @@ int main(int argc, char *argv[]) {
         cout << "Please enter GBN (Go-Back-N) or SR (Selective Repeat)\n";
         return 1;
     }
+    isGoBackN = (protocolType == "GBN");
 
     //prompt for packet size
     cout << "Packet size: \n> ";
@@ -579,6 +1163,7 @@ int main(int argc, char *argv[]) {
         if (timeoutMulti < 1) {
             timeoutMulti = 1;
         }
+        rtoEstimator.setRttFactor(timeoutMulti);
     }
 
     //prompt for sliding window size
@@ -594,13 +1179,81 @@ int main(int argc, char *argv[]) {
     cout << "Sequence range number: (0 = No range) \n> ";
     cin >> seqNumRange;
 
+    //prompt for integrity check
+    cout << "What integrity check? (\"Checksum\" or \"CRC32C\" or \"None\") \n> ";
+    cin >> integrityType;
+
+    // Quick validation - default to "Checksum"
+    if (integrityType != "CRC32C" && integrityType != "None") {
+        integrityType = "Checksum";
+    }
+
+    //prompt for transport
+    cout << "What transport? (\"TCP\" or \"UDP\") \n> ";
+    cin >> transportType;
+
+    // Quick validation - default to "TCP"
+    if (transportType != "UDP") {
+        transportType = "TCP";
+    }
+    clientSocket.setTransport((transportType == "UDP") ? NetSocket::TRANSPORT_UDP : NetSocket::TRANSPORT_TCP);
+
+    //prompt for congestion control
+    cout << "What congestion control? (\"None\" or \"AIMD\" or \"CUBIC\" or \"BBR\") \n> ";
+    cin >> congestionType;
+
+    // Quick validation - default to "None" (the sliding window is all we send)
+    congestionControl = CongestionControl::create(congestionType, slidingWindowSize);
+    if (!congestionControl) {
+        congestionType = "None";
+    }
+
+    //prompt for pacing
+    cout << "What pacing rate? (\"0\" = no pacing, a rate in Mbps, or \"Auto\" = from the congestion window and round trip) \n> ";
+    cin >> pacingType;
+
+    // Quick validation - default to "0" (packets go as fast as the window allows)
+    if (pacingType == "Auto") {
+        isAutoPacing = true;
+    } else {
+        pacingRateMbps = atof(pacingType.c_str());
+        if (pacingRateMbps <= 0) {
+            pacingRateMbps = 0;
+            pacingType = "0";
+        }
+    }
+    if (congestionControl) {
+        congestionControl->setPaced(pacingType != "0");
+    }
+
+    //prompt for fast retransmit
+    cout << "Fast retransmit once how many later packets are ACK'd? (0 = off, 3 = usual) \n> ";
+    cin >> reorderThreshold;
+
+    // Enforce 0 (off) or more
+    if (reorderThreshold < 0) {
+        reorderThreshold = 0;
+    }
+
+    // A packet has to fit in one datagram (the ASCII header is the largest)
+    if (transportType == "UDP" && packetSize + Packet::HEADER_ASCII_SIZE > (int) NetSocket::MAX_DATAGRAM_SIZE) {
+        cout << "Packet size is too large for UDP (max " << NetSocket::MAX_DATAGRAM_SIZE - Packet::HEADER_ASCII_SIZE << ")\n";
+        return 1;
+    }
+
     //prompt for artificial errors
-    cout << "What is the type of the error? (\"None\" or \"Random\" or \"User\") \n> ";
+    cout << "What is the type of the error? (\"None\" or \"Random\" or \"User\" or \"Reorder\") \n> ";
     cin >> artificialErrors;
 
     if (artificialErrors == "User") {
         promptForUserErrors();
 
+    // Reordering - how much?
+    } else if (artificialErrors == "Reorder") {
+        cout << "What percentage of packets should arrive out of order? (0-100) \n> ";
+        cin >> reorderPercent;
+        reorderPercent = min(100, max(0, reorderPercent));
+
     // Quick validation - default to "None"
     } else if (artificialErrors != "Random" && artificialErrors != "None") {
         artificialErrors = "None";
@@ -610,38 +1263,51 @@ int main(int argc, char *argv[]) {
     
     // FILE VALIDATION + GET FILE SIZE
     ifstream inFile(inputFileName, ios::binary | ios::ate);
-    int fileSize = inFile.tellg();
+    long long fileSize = inFile.tellg();
     if (fileSize < 0) {
         cout << "Cannot Read File: " << inputFileName << "\n";
         return 1;
     }
 
     // DETERMINE NUMBER OF CHUNKS + PACKETS
-    numPackets = (fileSize / packetSize) + 1;  
+    long long totalPackets = (fileSize / packetSize) + 1;  
     int finalChunkSize = (fileSize % packetSize);
 
     // Do we have a few more bytes remaining?
     if (finalChunkSize > 0) {
-        numPackets++;
+        totalPackets++;
     }
 
+    // Sequence numbers have to fit in the packet header
+    if (totalPackets > INT_MAX) {
+        cout << "File needs too many packets - please use a larger packet size.\n";
+        return 1;
+    }
+    numPackets = totalPackets;
+
     cout << "FILESIZE: " << fileSize << " | NUM PACKETS: " << numPackets << " | FINAL CHUNK: " << finalChunkSize << "\n";
 
     // CONNECT TO SOCKET
 	if (!clientSocket.createClientSocket(serverHost, serverPort)) {
         return 1;
     }
-
-    // No timeout specified? Calculate the timeout
-    if (timeoutMS == 0) {
-        calculateDynamicTimeout();
-    }
+    clientSocket.useAsyncIO();
 
     // First packet - provide details on the file itself (name + filesize)
     //      Note - This is a *required* first packet and will wait for successful ACK from the
     //          receiver to ensure it sent everything properly. Once good it'll move on to sending
     //          the actual file.
-    sendInitialFilePacket(outputFileName, fileSize);
+    if (!sendInitialFilePacket(outputFileName, fileSize)) {
+        return 1;
+    }
+
+    // Pacing - a fixed rate counts the headers we just agreed on (Auto starts with the first round trip).
+    // Paced sleeps are short, so don't let the kernel stretch them (by 50us, by default).
+    if (pacingType != "0") {
+        pacer.setRate(pacingRateMbps * 1000000 / 8, getFrameSize());
+        updatePacingRate();
+        prctl(PR_SET_TIMERSLACK, 1000UL);
+    }
 
     // Spin off a thread for reading ACK packets
     thread readACKMessagesThread(readACKMessages); 
@@ -653,56 +1319,105 @@ int main(int argc, char *argv[]) {
     // Set the initial window start - this is increased in the ACK process.
     slidingWindowFront = 1;
 
-    // Attempt to read the file in chunks
-    inFile.seekg(0); // Go back to beginning of file (due to originally going to end for file size)
+    // One pooled packet per sliding window slot, plus the ones being read ahead
+    readAheadDepth = min(MAX_READ_AHEAD_DEPTH, max(MIN_READ_AHEAD_DEPTH, READ_AHEAD_BYTES / packetSize));
+    packetPool.reserve(slidingWindowSize + readAheadDepth, packetSize);
+    sendWindow.reserve(slidingWindowSize);
+
+    // File reads go straight into the pool's arena - let io_uring use it as a registered buffer
+    fileIO.init(readAheadDepth);
+    fileIO.registerBuffer(packetPool.getArena(), packetPool.getArenaSize());
+
+    // Attempt to read the file in chunks - front to back, so let the kernel read further ahead than usual
+    inFile.close();
+    int inFileFD = open(inputFileName.c_str(), O_RDONLY);
+    posix_fadvise(inFileFD, 0, 0, POSIX_FADV_SEQUENTIAL);
     cout << "Reading File...\n";
 
-    // - Create a thread for every # based on windows size
-    // - Once we hit the # of windows sizes, hold until the first thread finishes. (.join)
-    // - Once that thread finishes, then get the next one in the list.
-    // - Ideally we'll have X threads running at any one time
-    // slidingwindowSize = 3;
+    // Reads run ahead of the sliding window, so the disk is busy while we wait on ACKs.
     int curChunkNum = 1; // Starts at 1 due to initial packet
-    int dataProcessed = 0;
-    string curFileBuff = "";
-    string nextFileBuff = "";
-    int fileSizeRead = 0;
-    while (!inFile.eof()) {
-        curChunkNum++;
+    int nextChunkToRead = 2;
+    bool isWindowMoving = true; // Did the receiver keep ACKing? (false = the connection closed with packets outstanding)
+    while (curChunkNum < numPackets) {
+
+        // Refill the read-ahead once half of it is sent, so a whole half goes to the kernel in one
+        //      system call while we send the other - each chunk is read straight into a pooled packet
+        if ((int) chunkReads.size() <= readAheadDepth / 2 && nextChunkToRead <= numPackets) {
+            prefetchFile(inFileFD, (long long) (nextChunkToRead - 2) * packetSize);
+
+            while ((int) chunkReads.size() < readAheadDepth && nextChunkToRead <= numPackets) {
+                int amountToRead = (nextChunkToRead == numPackets && finalChunkSize > 0) ? finalChunkSize : packetSize;
+                ChunkRead chunkRead = { packetPool.acquire(), nextChunkToRead, false };
+
+                if (!fileIO.submitRead(inFileFD, chunkRead.packet->prepareData(amountToRead), amountToRead,
+                        (long long) (nextChunkToRead - 2) * packetSize, nextChunkToRead)) {
+                    printf("Read Failed\n");
+                    return 1;
+                }
+                chunkReads.push_back(move(chunkRead));
+                nextChunkToRead++;
+            }
+        }
 
-        int amountToRead = (curChunkNum == numPackets && finalChunkSize > 0) ? finalChunkSize : packetSize;
+        // Collect the reads that are done (and hand new ones to the kernel)
+        AsyncIO::Completion completion;
+        bool isReadOk = true;
+        while (fileIO.getCompletion(completion, false)) {
+            isReadOk = markChunkRead(completion) && isReadOk;
+        }
 
-        // Create a char buffer to old the read file data.
-        vector <char> fileBuff(amountToRead, 0);
+        // Next chunk still not in? Then we have to wait for the disk (others may finish first).
+        if (!chunkReads.front().isDone) {
+            chrono::steady_clock::time_point waitStart = chrono::steady_clock::now();
+            while (!chunkReads.front().isDone && fileIO.getCompletion(completion, true)) {
+                isReadOk = markChunkRead(completion) && isReadOk;
+            }
+            readWaitNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - waitStart).count();
+            numReadWaits++;
+        }
 
-        // Read the chunk of data
-        if(!inFile.read(fileBuff.data(), amountToRead)) {
+        // The wait can also end because the I/O engine failed - then the chunk never arrived
+        if (!isReadOk || !chunkReads.front().isDone) {
             printf("Read Failed\n");
             return 1;
         }
+        curChunkNum++;
 
         // Process the data
-        processChunkData(fileBuff);
+        processChunkData(move(chunkReads.front().packet));
+        chunkReads.pop_front();
 
         // Check / Hold on the packet queue
-        // - This is a blocker until the file can continue. 
-        checkPacketQueue();
-
-        // Safety check to ensure we don't go over our expected packet count.
-        if (curChunkNum == numPackets) {
+        // - This is a blocker until the file can continue (a closed connection ends it here - the window can't move).
+        if (!checkPacketQueue()) {
+            isWindowMoving = false;
             break;
         }
     }
+    close(inFileFD);
 
-    // Wait until the queue is processed
-    checkPacketQueue(true);
+    // Wait until the queue is processed - only a window that drains means the receiver has everything
+    bool isComplete = isWindowMoving && checkPacketQueue(true);
 
     // Indicate we no longer need the ACK thread and wait for it to close.
     keepReadACK = false;
-    while (!hasACKClosed);
+    clientSocket.stopReceiving();
+    {
+        std::unique_lock<mutex> lock(ackMutex);
+        ackCondition.wait(lock, [] { return hasACKClosed; });
+    }
+
+    // UDP has no close for the receiver to see - tell it we're done so it can stop waiting for retransmissions.
+    if (clientSocket.getTransport() == NetSocket::TRANSPORT_UDP) {
+        clientSocket.sendData("DONE");
+    }
 
     // Close the socket
     clientSocket.closeSocket();
+    if (!isComplete) {
+        printf("Transfer aborted - the receiver stopped acknowledging with %d packets outstanding\n", sendWindow.size());
+        return 1;
+    }
     printf("Session successfully terminated\n");
 
     // Mark end time for file transfer.
@@ -713,7 +1428,7 @@ int main(int argc, char *argv[]) {
     int timeNumMin = (timeNumMS.count() / 60000);
 
     // Calculate the total throughput (Mbps)
-    double throughputBPS = (fileSize / timeNumMS.count()) * 1000;  // Bits Per Second
+    double throughputBPS = ((double) fileSize / max(1LL, (long long) timeNumMS.count())) * 1000;  // Bits Per Second (at least 1ms - batched sends can finish small files in under one)
     double throughputMbps = (throughputBPS / 1024 / 1024) * 8; // Megabits Per Second
     
     // Calculate effective throughput
@@ -725,6 +1440,69 @@ int main(int argc, char *argv[]) {
     printf("Number of retransmitted packets: %d\n", numRetrans);
     printf("Total elapsed time: %lldms = ~%dmin\n", timeNumMS.count(), timeNumMin);
     printf("Total throughput (Mbps): %f\n", throughputMbps);
+
+    // CPU used by the whole transfer (both threads)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0;
+    double systemSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+    printf("CPU time: %.3fs (user %.3fs | system %.3fs) | %.2f CPU-seconds per GB\n", userSeconds + systemSeconds, userSeconds, systemSeconds,
+        (fileSize > 0) ? (userSeconds + systemSeconds) / (fileSize / 1000000000.0) : 0.0);
+    printf("Transport: %s | Average ACK latency: %.1fus (%d samples)\n", NetSocket::getTransportName(clientSocket.getTransport()).c_str(),
+        (numAckLatencySamples > 0) ? (double) ackLatencyTotalUS / numAckLatencySamples : 0.0, numAckLatencySamples);
+    printf("Header bytes per packet: %d (%s)\n", Packet::getHeaderSize(headerVersion, integrity), (headerVersion == Packet::HEADER_BINARY) ? "binary" : "ASCII");
+    printf("Goodput ratio (file bytes / bytes sent): %f\n", (clientSocket.getBytesSent() > 0) ? (double) fileSize / clientSocket.getBytesSent() : 0.0);
+    if (integrity != Packet::INTEGRITY_NONE) {
+        printf("Checksum kernel: %s\n", Checksum::getKernelName((integrity == Packet::INTEGRITY_CRC32C) ? Checksum::getCrcKernel() : Checksum::getKernel()).c_str());
+    }
+
+    printf("Socket I/O: %s | Packets per syscall: send %f | receive %f\n", clientSocket.getIOName().c_str(),
+        (clientSocket.getNumSendCalls() > 0) ? (double) clientSocket.getNumFramesSent() / clientSocket.getNumSendCalls() : 0.0,
+        (clientSocket.getNumRecvCalls() > 0) ? (double) clientSocket.getNumFramesReceived() / clientSocket.getNumRecvCalls() : 0.0);
+    printf("Serialization saved by frame cache: %lld bytes\n", Packet::getFrameBytesSaved());
+    printf("Bytes copied per data byte: %f\n", (fileSize > 0) ? (double) Packet::getBytesCopied() / fileSize : 0.0);
+    printf("File I/O: %s%s | %lld reads | %lld system calls | %d chunks read ahead | waited %.1fms for reads (%lld times)\n",
+        AsyncIO::getEngineName(fileIO.getEngine()).c_str(), (fileIO.isBufferRegistered()) ? " with registered buffers" : "",
+        fileIO.getNumOperations(), fileIO.getNumSystemCalls(), readAheadDepth, readWaitNS / 1000000.0, numReadWaits);
+    printf("Packet pool: %d packets | %lld acquired | %lld heap allocations\n", packetPool.getCapacity(), packetPool.getNumAcquired(), packetPool.getNumHeapAllocs());
+    printf("Send window: %lld ACKs | %.1f ns per ACK (lookup + slide) | %.2f million ACKs/s\n", numACKsProcessed,
+        (double) windowTimeNS / max(1LL, numACKsProcessed), (windowTimeNS > 0) ? numACKsProcessed * 1000.0 / windowTimeNS : 0.0);
+    if (useSelectiveAcks) {
+        printf("Selective ACKs: %lld ACKs | %f packets per ACK | %lld packets marked from bitmaps\n", numACKsProcessed,
+            (double) numPackets / max(1LL, numACKsProcessed), numBitmapMarks);
+    }
+    if (isGoBackN) {
+        printf("Go-Back-N: %d go-backs | %f packets per ACK\n", numGoBacks, (double) numPackets / max(1LL, numACKsProcessed));
+    }
+    if (timeoutMS > 0) {
+        printf("Retransmission timeout: fixed %dms | smoothed RTT %.1fus | RTT variance %.1fus | %lld samples\n", timeoutMS,
+            rtoEstimator.getSmoothedUS(), rtoEstimator.getVarianceUS(), rtoEstimator.getNumSamples());
+    } else {
+        printf("Retransmission timeout: adaptive | smoothed RTT %.1fus | RTT variance %.1fus | %lld samples | %lld backoffs | now %.1fms | max %.1fms\n",
+            rtoEstimator.getSmoothedUS(), rtoEstimator.getVarianceUS(), rtoEstimator.getNumSamples(), rtoEstimator.getNumBackoffs(),
+            rtoEstimator.getTimeout().count() / 1000.0, rtoEstimator.getMaxTimeoutUS() / 1000.0);
+    }
+    if (reorderThreshold > 0) {
+        printf("Fast retransmit: %lld %s | reordering threshold %d\n", numFastRetransmits, (isGoBackN) ? "times went back" : "packets", reorderThreshold);
+    }
+    if (pacingType != "0") {
+        printf("Pacing: %s | average rate %.1f Mbps | %lld waits | average wait %.1fus\n", (isAutoPacing) ? "Auto" : "fixed",
+            pacer.getAverageRateMbps(), pacer.getNumWaits(), pacer.getAverageWaitUS());
+    }
+    if (congestionControl) {
+        printf("Congestion control: %s | average window %.1f | max window %d (of %d) | %lld loss events | %lld timeouts\n", congestionControl->getName().c_str(),
+            congestionControl->getAverageWindow(), congestionControl->getMaxWindowUsed(), slidingWindowSize, congestionControl->getNumLossEvents(), congestionControl->getNumTimeouts());
+    }
+    printf("Retransmission timers: %lld started | %lld cancelled | %lld expired | %lld cascaded | %.1f ns per packet\n",
+        retransmitTimers.getNumScheduled(), retransmitTimers.getNumCancelled(), retransmitTimers.getNumExpired(), retransmitTimers.getNumCascaded(),
+        (double) timerTimeNS / max(1, numPackets + numRetrans));
+
+    // Integrity CPU cost
+    long long integrityTimeNS = Packet::getIntegrityTimeNS();
+    long long integrityBytes = Packet::getIntegrityBytes();
+    printf("Integrity check (%s) CPU time: %lldus | %.1f ns/packet | %.2f GB/s\n", Packet::getIntegrityName(integrity).c_str(),
+        integrityTimeNS / 1000, (double) integrityTimeNS / max(1, numPackets + numRetrans),
+        (integrityTimeNS > 0) ? (double) integrityBytes / integrityTimeNS : 0.0);
     // printf("Effective throughput: %f (bits/sec)\n\n", effecThroughputbPS); // TODO: Implement Effect Throughput (w/ packets)
 
 	// DONE!
@@ -1,25 +1,158 @@
 /**
- * Client Test
- * 
- * This program listens for a connection and receives a file.
+ * Socket Framing Test
+ *
+ * This program connects to itself and sends back-to-back frames of random sizes, checking
+ * 		that every frame comes out whole and in order, and how many recv() calls it took.
+ *
+ * Two passes:
+ * 		Blocking - one sendData() per frame
+ * 		Async    - both ends on useAsyncIO(), frames queued in runs of random length (across
+ * 				   several send batches) and flushed with flushQueue(), with a sendData() mixed in
  */
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdlib>
 #include <unistd.h>
 #include "NetSockets.h"
 using namespace std;
 
+// Global Variables
+const int NUM_FRAMES = 20000;		// Frames to send
+const int MAX_TEST_FRAME = 70000;	// Largest frame (bigger than a single recv on most systems)
+const unsigned int SEED = 12345;	// Both sides generate the same frames from this
+const int MAX_QUEUED_FRAMES = 5 * NetSocket::SEND_BATCH_SIZE;	// Most frames queued before a flush (async pass)
+
+int numBadFrames = 0;		// Frames with the wrong length or content
+int numFramesChecked = 0;	// Frames the server checked
+long long numRecvCalls = 0;	// recv() calls the server made
+
+/**
+ * @brief Build test frame #i (its size and content come from the random generator)
+ */
+void buildFrame(unsigned int &seed, int i, string &frame) {
+	// Mostly small frames (like ACKs), with some large ones mixed in
+	int frameSize = (rand_r(&seed) % 4 == 0) ? (rand_r(&seed) % MAX_TEST_FRAME) + 1 : (rand_r(&seed) % 64) + 1;
+
+	frame.resize(frameSize);
+	for (int j = 0; j < frameSize; j++) {
+		frame[j] = (char) (i + j * 31);
+	}
+}
+
+/**
+ * @brief Receive and check every frame
+ */
+void runServer(int portNum, bool isAsync) {
+	NetSocket serverSocket;
+	serverSocket.createServerSocket(portNum);
+	if (isAsync) {
+		serverSocket.useAsyncIO();
+	}
+
+	unsigned int seed = SEED;
+	string expected;
+
+	for (int i = 0; i < NUM_FRAMES; i++) {
+		const char *frameData;
+		size_t frameLen;
+
+		if (!serverSocket.getFrame(frameData, frameLen)) {
+			cout << "Socket closed after " << i << " frames\n";
+			numBadFrames += NUM_FRAMES - i;
+			break;
+		}
+
+		buildFrame(seed, i, expected);
+		if (frameLen != expected.length() || expected.compare(0, frameLen, frameData, frameLen) != 0) {
+			numBadFrames++;
+		}
+		numFramesChecked++;
+	}
+
+	numRecvCalls = serverSocket.getNumRecvCalls();
+	serverSocket.closeSocket();
+}
+
+/**
+ * @brief Send every frame to our own server and check what it got
+ *
+ * @return bool (true = every frame came through)
+ */
+bool runPass(const string &serverIp, int portNum, bool isAsync) {
+	numBadFrames = 0;
+	numFramesChecked = 0;
+	numRecvCalls = 0;
+
+	// Start listening, then give the server a moment before we connect
+	thread serverThread(runServer, portNum, isAsync);
+	sleep(1);
+
+	NetSocket clientSocket;
+	clientSocket.createClientSocket(serverIp, portNum);
+	if (isAsync) {
+		printf("Socket I/O: %s\n", AsyncIO::getEngineName(clientSocket.useAsyncIO()).c_str());
+	}
+
+	// Send everything back-to-back - TCP is free to merge and split these however it likes
+	unsigned int seed = SEED;
+	unsigned int queueSeed = SEED + 1;
+	string frame;
+	long long bytesSent = 0;
+	int numQueued = 0;
+	int queueRun = 0;
+
+	for (int i = 0; i < NUM_FRAMES; i++) {
+		buildFrame(seed, i, frame);
+		bytesSent += frame.length();
+
+		if (!isAsync) {
+			clientSocket.sendData(frame);
+			continue;
+		}
+
+		// Every so often a frame goes straight out - it has to land after the ones queued before it
+		if (numQueued == 0 && rand_r(&queueSeed) % 8 == 0) {
+			clientSocket.sendData(frame);
+			continue;
+		}
+
+		// The queue holds its own copy, so we can build the next frame in ours right away
+		if (numQueued == 0) {
+			queueRun = (rand_r(&queueSeed) % MAX_QUEUED_FRAMES) + 1;
+		}
+		clientSocket.queueFrame(make_shared<const string>(frame));
+		numQueued++;
+
+		if (numQueued == queueRun || i == NUM_FRAMES - 1) {
+			clientSocket.flushQueue();
+			numQueued = 0;
+		}
+	}
+	cout << "Sent " << NUM_FRAMES << " frames (" << bytesSent << " bytes)\n";
+
+	serverThread.join();
+	clientSocket.closeSocket();
+
+	// Results
+	printf("Frames checked: %d | Bad frames: %d\n", numFramesChecked, numBadFrames);
+	printf("Receive syscalls: %lld | Syscalls per frame: %f\n", numRecvCalls, (numFramesChecked > 0) ? (double) numRecvCalls / numFramesChecked : 0.0);
+
+	return numBadFrames == 0;
+}
+
 int main(int argc, char *argv[]) {
 
-	// Global Variables
 	string serverIp;
 	int portNum;
 
 	// Make sure user provided a port
 	if (argc != 3) {
-		cout << "Please provide a port # above 1024 as a parameter.\n";
-		cout << "Example: ./receiver xxx.xxx.xxx.xxx 10000\n";
+		cout << "Please provide an IP and a port # above 1024 as parameters.\n";
+		cout << "Example: ./socket-client-test 127.0.0.1 10000\n";
 		return 1;
 	}
 
@@ -40,26 +173,13 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	// Create the socket and listen
-	NetSocket clientSocket;
-	clientSocket.createClientSocket(serverIp, portNum);
-	sleep(2);
-	clientSocket.sendData("Hello");
-	cout << "Sent Hello\n";
-	sleep(2);
-	clientSocket.sendData("Hello2");
-	cout << "Sent Hello2\n";
-	sleep(2);
-	clientSocket.sendData("STOP");
-	cout << "Sent STOP\n";
-
-	cout << "Good Bye";
-
-	// Handle receiving file
+	cout << "Blocking sends\n";
+	bool isPassed = runPass(serverIp, portNum, false);
 
-	// Parse packet
+	cout << "\nAsync sends (queued batches)\n";
+	isPassed = runPass(serverIp, portNum, true) && isPassed;
 
-	// Store file
+	cout << ((isPassed) ? "PASSED\n" : "FAILED\n");
 
-	return 0;
-}
\ No newline at end of file
+	return (isPassed) ? 0 : 1;
+}